@@ -37,6 +37,7 @@
 #include "../header/INA219.h"
 #include "../../header/curr_time.h"
 #include "../../../linux_programming/header/genServer.h"
+#include "INAburst.h"
 
 /****************************************************************/
 /***************** Global Variable Definitions ******************/
@@ -118,6 +119,11 @@ int main(int argc, char *argv[])
 
   MEASURE_DATA sIna_measuring = {};
 
+  // INA219 on the bus and raw registers read by one burst
+  ina_bus_s sInaBus;
+  ina_burst_s sInaBurst;
+  int burstErr;
+
   // Variable keeping real voltage and current values
   double realShuntVoltVal = 0.0;
   double realBusVoltVal = 0.0;
@@ -199,6 +205,7 @@ int main(int argc, char *argv[])
 
   // Open i2c device with INA's slave address to communicate with INA
   i2cfd = i2c_init(argv[1], INA_SLV_ADDR);
+  inaBusInit(&sInaBus, i2cfd, INA_SLV_ADDR);
 
 #ifdef DEBUG
   fprintf(tx,
@@ -354,19 +361,21 @@ int main(int argc, char *argv[])
        fgets(command, sizeof command, rx);
        if (strcmp(command, "log") == 0) {
 
-	 // Read value from shunt voltage register
-	 numRead = i2c_read_data_word(i2cfd, &shunt, RDbuf);
-	 if (numRead == -1) {
+	 /* Read shunt, bus, power and current register in one combined
+	    transfer, so all values belong to the same conversion */
+	 burstErr = inaBurstRead(&sInaBus, &sInaBurst);
+
+	 // Check value from shunt voltage register
+	 if (burstErr & BURST_SHUNT) {
 	   fprintf(tx,
 		   "{ \"ERROR\":\"i2c_read_data_word(shunt-volt-reg)\" }\n");
 	   exit(EXIT_FAILURE);
 	 }
 
-	 strtosh(RDbuf, sIna_measuring.shuntRegVal)
+	 sIna_measuring.shuntRegVal = sInaBurst.shuntRegVal;
 	 
-	 // Read value from bus voltage register
-	 numRead = i2c_read_data_word(i2cfd, &bus, RDbuf);
-	 if (numRead == -1) {
+	 // Check value from bus voltage register
+	 if (burstErr & BURST_BUS) {
 	   fprintf(tx,
 		   "{ \"ERROR\":\"i2c_read_data_word(bus-volt-reg)\" }\n");
 	   exit(EXIT_FAILURE);
@@ -382,23 +391,23 @@ int main(int argc, char *argv[])
 	 }
 	 
 	 // Make bus voltage conversions
-	 strtosh(RDbuf, sIna_measuring.busRegVal)
+	 sIna_measuring.busRegVal = sInaBurst.busRegVal;
 	 if (sIna_measuring.busRegVal & CNVR)
 	   realBusVoltVal = busVoltConv(sIna_measuring.busRegVal);
 	 else{
 	    printf("Bus voltage not measured this time\n");
 	 }
 
-	 // Read value from current register
-	 numRead = i2c_read_data_word(i2cfd, &current, RDbuf);
-	 if (numRead == -1) {
+	 // Check value from current register
+	 if (burstErr & BURST_CURR) {
 	   fprintf(tx,
 		   "{ \"ERROR\":\"i2c_read_data_word(current-reg)\" }\n");
 	   exit(EXIT_FAILURE);
 	 }
 
 	 // Make current conversions
-	 strtosh(RDbuf, sIna_measuring.currRegVal)
+	 sIna_measuring.currRegVal = sInaBurst.currRegVal;
+	 sIna_measuring.powerRegVal = sInaBurst.powerRegVal;
 	 realCurrVal = currConv(sIna_measuring.currRegVal);
 
 #ifdef DEBUG
@@ -0,0 +1,605 @@
+/*****************************************************************
+ * Title    : INAacq.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Acquisition workers, one per i2c bus, which alone
+ *            talk to INA219 devices and publish latest sample of
+ *            each via seqlock in shared memory, so client handlers
+ *            never touch the i2c bus
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <signal.h>
+#include <time.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/error_functions.h"
+#include "../header/INA219.h"
+#include "INAburst.h"
+#include "INAring.h"
+#include "INAconf.h"
+#include "INAstats.h"
+#include "INAhist.h"
+#include "INAenergy.h"
+#include "INAacq.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+// How often realtime offset of timestamps is measured again
+#define RT_OFFSET_REFRESH_NS  1000000000LL
+
+/* Scheduler tuning, fractions of conversion period. Deadline runs
+ * ahead by 1/DRIFT_DIV a period, which covers the tolerance of INA219
+ * oscillator, and a read which came before conversion end is retried
+ * 1/RETRY_DIV a period later, at most CNVR_RETRIES times */
+#define SCHED_DRIFT_DIV     128
+#define SCHED_RETRY_DIV     8
+#define SCHED_CNVR_RETRIES  SCHED_RETRY_DIV
+
+// Polling period when ADC is off and no conversion ever completes
+#define SCHED_IDLE_US       100000
+
+/* Longer gap between two conversions, in periods, is not integrated,
+ * something stopped conversions (configuration, stall, bus error) */
+#define INTEG_GAP_PERIODS   4
+
+/**************** New Local Types Definitions *******************/
+
+// Scheduling state of one channel inside worker of its bus
+typedef struct acq_run {
+  acq_chan_s *chan;
+  stats_chan_s *stats;
+  trig_chan_s *trig;
+  hist_chan_s *hist;
+  ring_hdr_s *ring;
+  const char *busPath;
+  ina_bus_s bus;
+  acq_sample_s smp;             // Last published sample
+  long long periodNs;           // Period deadlines are scheduled at
+  long long deadline;           // Next wake-up, CLOCK_MONOTONIC ns
+  long long rtNextNs;           // Next realtime offset refresh
+  uint32_t confSeq;             // Mailbox request applied last
+  int retries;                  // Reads retried for current conversion
+  int64_t integNs;              // Last integrated conversion, 0 = none
+  double integW, integA;        // and its power and current
+} acq_run_s;
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static int acqRead(ina_bus_s *bus, acq_sample_s *smp);
+static void acqLoop(acq_run_s *run, int nrun);
+static void acqService(acq_run_s *run);
+static void acqRingPush(ring_hdr_s *ring, const acq_sample_s *smp,
+			ring_sample_s *rs);
+static void acqIntegrate(acq_run_s *run);
+static uint32_t acqConfApply(acq_chan_s *chan, ina_bus_s *bus, ina_conf_s *conf);
+static long long schedPeriodNs(acq_chan_s *chan, const ina_conf_s *conf);
+static void mboxLock(acq_mbox_s *mbox);
+static long adcConvTimeUs(unsigned int adc);
+static int64_t rtOffsetNs(void);
+
+/**************** Global Functions Definitions ******************/
+
+/* Create anonymous shared mapping of nchan channels before any
+ * fork(), so every forked client handler inherits the same cache */
+acq_shared_s *acqCreate(int nchan)
+{
+  acq_shared_s *shm;
+  pthread_mutexattr_t mtxAttr;
+  int s, ch;
+
+  shm = mmap(NULL, sizeof(acq_shared_s), PROT_READ | PROT_WRITE,
+	     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shm == MAP_FAILED)
+    errExit("mmap(acq_shared_s)");
+
+  memset(shm, 0, sizeof(acq_shared_s));
+  shm->nchan = nchan;
+
+  // Zero-filled already, pages of unused buckets are not even allocated
+  shm->stats = mmap(NULL, nchan * sizeof(stats_chan_s), PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shm->stats == MAP_FAILED)
+    errExit("mmap(stats_chan_s)");
+
+  // Capture buffers too are touched only once trigger is armed
+  shm->trig = mmap(NULL, nchan * sizeof(trig_chan_s), PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shm->trig == MAP_FAILED)
+    errExit("mmap(trig_chan_s)");
+
+  // Coarse levels fill up over days, their pages come as they do
+  shm->hist = mmap(NULL, nchan * sizeof(hist_chan_s), PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shm->hist == MAP_FAILED)
+    errExit("mmap(hist_chan_s)");
+
+  /* Mailbox mutex is taken by client handlers, one of them may die
+     holding it, robust mutex lets the others go on */
+  s = pthread_mutexattr_init(&mtxAttr);
+  if (s != 0)
+    errExitEN(s, "pthread_mutexattr_init");
+  s = pthread_mutexattr_setpshared(&mtxAttr, PTHREAD_PROCESS_SHARED);
+  if (s != 0)
+    errExitEN(s, "pthread_mutexattr_setpshared");
+  s = pthread_mutexattr_setrobust(&mtxAttr, PTHREAD_MUTEX_ROBUST);
+  if (s != 0)
+    errExitEN(s, "pthread_mutexattr_setrobust");
+  for (ch = 0; ch < nchan; ch++) {
+    s = pthread_mutex_init(&shm->chan[ch].mbox.mutex, &mtxAttr);
+    if (s != 0)
+      errExitEN(s, "pthread_mutex_init(mbox)");
+    trigInit(&shm->trig[ch], &mtxAttr);
+  }
+  pthread_mutexattr_destroy(&mtxAttr);
+
+  energyInit(&shm->energy);
+
+  return shm;
+}
+
+/* Take first sample of every device synchronously, so the cache is
+ * valid before the server accepts any client, then fork one worker
+ * per bus, so buses are sampled in parallel. devs holds shm->nchan
+ * devices with configuration already written, samples of a device
+ * go to its ring too, unless it is NULL.
+ * Puts pids of workers in pids and returns their number */
+int acqStart(acq_shared_s *shm, acq_dev_s *devs, pid_t *pids)
+{
+  acq_run_s *run, tmp;
+  ring_sample_s rs;
+  int nworker = 0;
+  int first, ch, j;
+
+  run = calloc(shm->nchan, sizeof(acq_run_s));
+  if (run == NULL)
+    errExit("calloc(acq_run_s)");
+
+  for (ch = 0; ch < shm->nchan; ch++) {
+    run[ch].chan = &shm->chan[ch];
+    run[ch].stats = &shm->stats[ch];
+    run[ch].trig = &shm->trig[ch];
+    run[ch].hist = &shm->hist[ch];
+    run[ch].ring = devs[ch].ring;
+    run[ch].busPath = devs[ch].busPath;
+    run[ch].bus = devs[ch].bus;
+
+    shm->chan[ch].mbox.conf = devs[ch].conf;
+    run[ch].smp.conf = devs[ch].conf;
+    run[ch].periodNs = schedPeriodNs(&shm->chan[ch], &devs[ch].conf);
+    run[ch].smp.rtOffsetNs = rtOffsetNs();
+
+    run[ch].smp.err = acqRead(&run[ch].bus, &run[ch].smp);
+    run[ch].smp.seq = 1;
+    acqPublish(&shm->chan[ch], &run[ch].smp);
+    acqRingPush(run[ch].ring, &run[ch].smp, &rs);
+
+    run[ch].deadline = run[ch].smp.tsNs + run[ch].periodNs -
+      run[ch].periodNs / SCHED_DRIFT_DIV;
+    run[ch].rtNextNs = run[ch].smp.tsNs + RT_OFFSET_REFRESH_NS;
+  }
+
+  // Gather channels of one bus together, keeping their order
+  for (first = 0; first < shm->nchan; first = j) {
+    for (j = first + 1, ch = first + 1; ch < shm->nchan; ch++)
+      if (strcmp(run[ch].busPath, run[first].busPath) == 0) {
+	tmp = run[ch];
+	memmove(&run[j + 1], &run[j], (ch - j) * sizeof(acq_run_s));
+	run[j++] = tmp;
+      }
+
+    switch (pids[nworker] = fork()) {
+    case -1:
+      errExit("fork(acquisition)");
+
+    case 0:
+      // Do not outlive the server
+      if (prctl(PR_SET_PDEATHSIG, SIGTERM) == -1)
+	errMsg("prctl(PR_SET_PDEATHSIG)");
+      if (getppid() == 1)
+	_exit(EXIT_FAILURE);
+
+      acqLoop(&run[first], j - first);
+      _exit(EXIT_FAILURE);
+
+    default:
+      nworker++;
+      break;
+    }
+  }
+
+  free(run);
+  return nworker;
+}
+
+// Seqlock writer side, only acquisition worker of channel calls it
+void acqPublish(acq_chan_s *chan, const acq_sample_s *smp)
+{
+  uint32_t seq;
+
+  seq = __atomic_load_n(&chan->lock, __ATOMIC_RELAXED);
+  __atomic_store_n(&chan->lock, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  chan->sample = *smp;
+
+  __atomic_store_n(&chan->lock, seq + 2, __ATOMIC_RELEASE);
+}
+
+// Seqlock reader side, retries while writer is in the middle of update
+void acqSnapshot(acq_chan_s *chan, acq_sample_s *smp)
+{
+  uint32_t seq1, seq2;
+
+  do {
+    seq1 = __atomic_load_n(&chan->lock, __ATOMIC_ACQUIRE);
+    *smp = chan->sample;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    seq2 = __atomic_load_n(&chan->lock, __ATOMIC_RELAXED);
+  } while ((seq1 & 1) || seq1 != seq2);
+}
+
+/* Time in microseconds needed for one complete conversion cycle
+ * of the mode programmed in configuration register */
+long acqConvPeriodUs(short confRegVal)
+{
+  unsigned int mode = confRegVal & CONF_MODE_MASK;
+  long period = 0;
+
+  if (mode & 0x1)            // shunt voltage converted
+    period += adcConvTimeUs((confRegVal >> CONF_SADC_SHIFT) & CONF_ADC_MASK);
+  if (mode & 0x2)            // bus voltage converted
+    period += adcConvTimeUs((confRegVal >> CONF_BADC_SHIFT) & CONF_ADC_MASK);
+
+  return period;
+}
+
+// CLOCK_MONOTONIC time in ns, common time base of server
+long long acqNowNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Time of sample in ns since Epoch
+int64_t acqWallNs(const acq_sample_s *smp)
+{
+  return smp->tsNs + smp->rtOffsetNs;
+}
+
+/* Lock configuration mailbox of channel and return requested
+ * configuration, which caller may change. Release it soon by
+ * acqConfEnd() */
+ina_conf_s *acqConfBegin(acq_chan_s *chan)
+{
+  mboxLock(&chan->mbox);
+  return &chan->mbox.conf;
+}
+
+/* Unlock configuration mailbox. If "post" is set, configuration was
+ * changed and acquisition worker applies it at its next wake-up */
+void acqConfEnd(acq_chan_s *chan, int post)
+{
+  if (post)
+    __atomic_store_n(&chan->mbox.reqSeq, chan->mbox.reqSeq + 1, __ATOMIC_RELEASE);
+
+  pthread_mutex_unlock(&chan->mbox.mutex);
+}
+
+/* Shunt voltage in uV. Sign is dropped, as server always reported
+ * it. Register LSB is 10 uV whatever the PGA range */
+int64_t acqShuntUv(const acq_sample_s *smp)
+{
+  int64_t val = smp->shuntRegVal;
+
+  return (val < 0 ? -val : val) * ACQ_SHUNT_LSB_UV;
+}
+
+/* Load voltage in uV, bus voltage plus shunt voltage. Bus voltage
+ * is in the upper 13 bits of its register, LSB is 4 mV */
+int64_t acqVoltageUv(const acq_sample_s *smp)
+{
+  return ((uint16_t)smp->busRegVal >> 3) * ACQ_BUS_LSB_UV + acqShuntUv(smp);
+}
+
+/* Current in uA, rounded half away from zero. Scaled by calibration
+ * sample was taken with */
+int64_t acqCurrentUa(const acq_sample_s *smp)
+{
+  int64_t pa = smp->currRegVal * smp->conf.currLsbPa;
+
+  return (pa + (pa < 0 ? -500000 : 500000)) / 1000000;
+}
+
+// Shunt voltage in mV, see acqShuntUv()
+double acqShuntMv(const acq_sample_s *smp)
+{
+  return acqShuntUv(smp) / 1e3;
+}
+
+// Load voltage in V
+double acqVoltage(const acq_sample_s *smp)
+{
+  return acqVoltageUv(smp) / 1e6;
+}
+
+/* Current in A with full resolution of current LSB, not rounded to
+ * uA as acqCurrentUa(), so statistics, energy and history keep it */
+double acqCurrent(const acq_sample_s *smp)
+{
+  return smp->currRegVal * smp->conf.currLsbPa / 1e12;
+}
+
+// Power in W, power register LSB is 20 times current LSB
+double acqPower(const acq_sample_s *smp)
+{
+  return (unsigned short)smp->powerRegVal * 20 * smp->conf.currLsbA;
+}
+
+/* True if sample carries a new conversion, i.e. CNVR was set when
+ * acquisition worker read it */
+int acqFresh(const acq_sample_s *smp)
+{
+  return !(smp->err & ACQ_ERR_BUS) && (smp->busRegVal & CNVR);
+}
+
+/***************** Local Functions Definitions ******************/
+
+/* Read shunt, bus, power and current register into smp, all of them
+ * taken in one burst so they belong to the same conversion.
+ * Returns ACQ_ERR_* bits of registers which failed to read */
+static int acqRead(ina_bus_s *bus, acq_sample_s *smp)
+{
+  ina_burst_s regs;
+  int err;
+
+  err = inaBurstRead(bus, &regs);
+  smp->tsNs = acqNowNs();
+
+  if (!(err & ACQ_ERR_SHUNT))
+    smp->shuntRegVal = regs.shuntRegVal;
+  if (!(err & ACQ_ERR_BUS))
+    smp->busRegVal = regs.busRegVal;
+  if (!(err & ACQ_ERR_POWER))
+    smp->powerRegVal = regs.powerRegVal;
+  if (!(err & ACQ_ERR_CURR))
+    smp->currRegVal = regs.currRegVal;
+
+  return err;
+}
+
+/* Main loop of acquisition worker of one bus. Devices on the bus
+ * convert on their own clocks, the worker sleeps to deadline of
+ * whichever is due first and serves it */
+static void acqLoop(acq_run_s *run, int nrun)
+{
+  struct timespec ts;
+  int next, j;
+
+  for (;;) {
+    for (next = 0, j = 1; j < nrun; j++)
+      if (run[j].deadline < run[next].deadline)
+	next = j;
+
+    ts.tv_sec = run[next].deadline / 1000000000LL;
+    ts.tv_nsec = run[next].deadline % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+      continue;
+
+    acqService(&run[next]);
+  }
+}
+
+/* Serve one channel at its deadline, one published sample per
+ * conversion. Deadline is just after conversion end and the read
+ * confirms it by CNVR bit, which is left in published bus register
+ * as fresh flag. Deadline advances a bit less than period, so it
+ * creeps before conversion end of the real device clock; read which
+ * comes too early is retried shortly after and shifts deadline behind
+ * conversion end again. In triggered modes next conversion is started
+ * right after the read. Without CNVR after all retries stale sample
+ * is published, so readers see that conversions stopped.
+ * Configuration requested through mailbox is applied at wake-up.
+ * Read failures are published in err and the worker keeps going, so
+ * a bus glitch does not take whole server down */
+static void acqService(acq_run_s *run)
+{
+  acq_chan_s *chan = run->chan;
+  acq_sched_s *sched = &chan->sched;
+  acq_sample_s *smp = &run->smp;
+  ring_sample_s rs;
+  long long latNs;
+  double volt, curr;
+
+  // Writing configuration restarts conversion, wait for a whole one
+  if (__atomic_load_n(&chan->mbox.reqSeq, __ATOMIC_ACQUIRE) != run->confSeq) {
+    run->confSeq = acqConfApply(chan, &run->bus, &smp->conf);
+    run->periodNs = schedPeriodNs(chan, &smp->conf);
+    if (run->ring != NULL)
+      __atomic_store_n(&run->ring->periodUs, chan->periodUs, __ATOMIC_RELAXED);
+    run->deadline = acqNowNs() + run->periodNs;
+    run->retries = 0;
+    return;
+  }
+
+  smp->err = acqRead(&run->bus, smp);
+
+  if (!(smp->err & ACQ_ERR_BUS) && !acqFresh(smp) &&
+      chan->periodUs && run->retries < SCHED_CNVR_RETRIES) {
+    __atomic_store_n(&sched->cnvrMisses, sched->cnvrMisses + 1, __ATOMIC_RELAXED);
+    run->deadline += run->periodNs / SCHED_RETRY_DIV;
+    run->retries++;
+    return;
+  }
+
+  // Wake-up and bus time past the deadline, the sampling jitter
+  latNs = smp->tsNs - run->deadline;
+  __atomic_store_n(&sched->latSumNs, sched->latSumNs + latNs, __ATOMIC_RELAXED);
+  if (latNs > sched->latMaxNs)
+    __atomic_store_n(&sched->latMaxNs, latNs, __ATOMIC_RELAXED);
+  if (!(smp->err & ACQ_ERR_BUS) && !acqFresh(smp))
+    __atomic_store_n(&sched->stale, sched->stale + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&sched->samples, sched->samples + 1, __ATOMIC_RELAXED);
+
+  if (confTriggered(&smp->conf)) {
+    // Failed trigger shows up as stale samples
+    inaRegWrite(&run->bus, config_reg, smp->conf.confRegVal);
+    run->deadline = acqNowNs() + run->periodNs;
+  }
+  else {
+    // After a stall (suspend, debugger) start over instead of catching up
+    run->deadline += run->periodNs - run->periodNs / SCHED_DRIFT_DIV;
+    if (run->deadline < smp->tsNs)
+      run->deadline = smp->tsNs + run->periodNs - run->periodNs / SCHED_DRIFT_DIV;
+  }
+  run->retries = 0;
+
+  smp->seq++;
+
+  // Follow clock steps and NTP slewing, but not at every sample
+  if (smp->tsNs >= run->rtNextNs) {
+    smp->rtOffsetNs = rtOffsetNs();
+    run->rtNextNs = smp->tsNs + RT_OFFSET_REFRESH_NS;
+  }
+
+  acqIntegrate(run);
+  acqPublish(chan, smp);
+  acqRingPush(run->ring, smp, &rs);
+  trigPush(run->trig, smp, &rs);
+
+  // Stale sample would count the same conversion twice
+  if (acqFresh(smp) && !(smp->err & (ACQ_ERR_SHUNT | ACQ_ERR_BUS | ACQ_ERR_CURR))) {
+    volt = acqVoltage(smp);
+    curr = acqCurrent(smp);
+    statsAdd(run->stats, smp->tsNs, volt, curr);
+    // Signed power, the same one energy is integrated from
+    histAdd(run->hist, acqWallNs(smp), volt, curr, volt * curr);
+  }
+}
+
+/* Add energy and charge since previous conversion to totals of the
+ * sample, trapezoid between the two. Power is bus voltage times
+ * current, as INA219 computes it, but keeping sign of current which
+ * power register drops. Gaps are left out, totals only cover time
+ * conversions were actually read */
+static void acqIntegrate(acq_run_s *run)
+{
+  acq_sample_s *smp = &run->smp;
+  double watt, amp, dt;
+
+  if (!acqFresh(smp) || (smp->err & (ACQ_ERR_BUS | ACQ_ERR_CURR))) {
+    if (smp->err)
+      run->integNs = 0;
+    return;
+  }
+
+  amp = acqCurrent(smp);
+  watt = busVoltConv(smp->busRegVal) * amp;
+
+  if (run->integNs != 0 &&
+      smp->tsNs - run->integNs <= INTEG_GAP_PERIODS * run->periodNs) {
+    dt = (smp->tsNs - run->integNs) / 1e9;
+    smp->energyJ += (watt + run->integW) / 2 * dt;
+    smp->chargeC += (amp + run->integA) / 2 * dt;
+  }
+
+  run->integNs = smp->tsNs;
+  run->integW = watt;
+  run->integA = amp;
+}
+
+/* Put sample in ring form to rs, for trigger too, and push it to
+ * ring unless it is NULL */
+static void acqRingPush(ring_hdr_s *ring, const acq_sample_s *smp,
+			ring_sample_s *rs)
+{
+  rs->seq = smp->seq;
+  rs->err = smp->err;
+  rs->tsNs = acqWallNs(smp);
+  rs->shuntRegVal = smp->shuntRegVal;
+  rs->busRegVal = smp->busRegVal;
+  rs->currRegVal = smp->currRegVal;
+  rs->powerRegVal = smp->powerRegVal;
+  rs->currLsbA = smp->conf.currLsbA;
+
+  if (ring != NULL)
+    ringPush(ring, rs);
+}
+
+/* Take requested configuration from mailbox and write it to INA219,
+ * calibration first, since configuration write restarts conversion.
+ * Applied configuration is put in conf, which is left as it was if
+ * the write failed. Returns mailbox sequence of the request */
+static uint32_t acqConfApply(acq_chan_s *chan, ina_bus_s *bus, ina_conf_s *conf)
+{
+  ina_conf_s req;
+  uint32_t seq;
+
+  mboxLock(&chan->mbox);
+  req = chan->mbox.conf;
+  seq = chan->mbox.reqSeq;
+  pthread_mutex_unlock(&chan->mbox.mutex);
+
+  if (inaRegWrite(bus, calib_reg, req.calibRegVal) == -1 ||
+      inaRegWrite(bus, config_reg, req.confRegVal) == -1) {
+    errMsg("inaRegWrite(config)");
+    return seq;
+  }
+
+  *conf = req;
+  return seq;
+}
+
+/* Set conversion period of conf in shared memory and return period
+ * the worker schedules at, ADC off falls back to idle polling */
+static long long schedPeriodNs(acq_chan_s *chan, const ina_conf_s *conf)
+{
+  chan->periodUs = acqConvPeriodUs(conf->confRegVal);
+
+  return (chan->periodUs ? chan->periodUs : SCHED_IDLE_US) * 1000LL;
+}
+
+/* Lock mailbox mutex. If a client handler died holding it, request
+ * is just taken over as it is */
+static void mboxLock(acq_mbox_s *mbox)
+{
+  int s;
+
+  s = pthread_mutex_lock(&mbox->mutex);
+  if (s == EOWNERDEAD)
+    s = pthread_mutex_consistent(&mbox->mutex);
+  if (s != 0)
+    errExitEN(s, "pthread_mutex_lock(mbox)");
+}
+
+/* Conversion time of one ADC setting (BADC/SADC field),
+ * INA219 datasheet, table 5 */
+static long adcConvTimeUs(unsigned int adc)
+{
+  static const long resTime[] = { 84, 148, 276, 532 };
+  static const long avgTime[] = { 532, 1060, 2130, 4260,
+				  8510, 17020, 34050, 68100 };
+
+  if (adc & 0x8)
+    return avgTime[adc & 0x7];
+
+  return resTime[adc & 0x3];
+}
+
+/* Offset of CLOCK_REALTIME against CLOCK_MONOTONIC. Realtime reading
+ * is taken against the middle of two monotonic ones */
+static int64_t rtOffsetNs(void)
+{
+  struct timespec rt;
+  long long mono1, mono2;
+
+  mono1 = acqNowNs();
+  clock_gettime(CLOCK_REALTIME, &rt);
+  mono2 = acqNowNs();
+
+  return (int64_t)rt.tv_sec * 1000000000LL + rt.tv_nsec - (mono1 + (mono2 - mono1) / 2);
+}
@@ -0,0 +1,130 @@
+/*****************************************************************
+ * Title    : INAacq.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Acquisition workers owning INA219 devices and the
+ *            shared latest-sample cache of every device (channel)
+ *            read by client handlers
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INAACQ_H
+#define INAACQ_H
+
+/************************** Includes ****************************/
+#include <stdint.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include "INAburst.h"
+#include "INAring.h"
+#include "INAconf.h"
+#include "INAstats.h"
+#include "INAhist.h"
+#include "INAenergy.h"
+#include "INAtrig.h"
+
+/************ Global Symbolic Constant Definitions **************/
+
+// Bits of acq_sample_s.err, one per register which failed to read
+#define ACQ_ERR_SHUNT  BURST_SHUNT
+#define ACQ_ERR_BUS    BURST_BUS
+#define ACQ_ERR_CURR   BURST_CURR
+#define ACQ_ERR_POWER  BURST_POWER
+
+// Register LSBs of fixed-point conversions (INA219 datasheet, 8.6.3)
+#define ACQ_SHUNT_LSB_UV  10
+#define ACQ_BUS_LSB_UV    4000
+
+// Most INA219 devices one server samples, 16 addresses on two buses
+#define ACQ_MAX_CHAN   32
+
+/**************** New Global Types Definitions ******************/
+
+/* One acquired sample. Raw register values are kept in the same
+ * form as in measured_data_s, conversion is left to the reader */
+typedef struct acq_sample {
+  uint32_t seq;                 // Sequence number, 0 = no sample yet
+  int err;                      // ACQ_ERR_* bits of failed reads
+  int64_t tsNs;                 // Read completion, CLOCK_MONOTONIC ns
+  int64_t rtOffsetNs;           // CLOCK_REALTIME minus CLOCK_MONOTONIC
+  short shuntRegVal;
+  short busRegVal;
+  short currRegVal;
+  short powerRegVal;
+  ina_conf_s conf;              // Configuration sample was taken with
+  double energyJ;               // Power and current integrated over
+  double chargeC;               // conversions since start
+} acq_sample_s;
+
+/* Counters of acquisition scheduler, written by acquisition worker
+ * only. Read them with __atomic_load_n(), each one on its own */
+typedef struct acq_sched {
+  uint32_t samples;             // Published samples
+  uint32_t stale;               // Published without new conversion
+  uint32_t cnvrMisses;          // Reads retried, conversion not done
+  int64_t latSumNs;             // Sum and maximum of read time past
+  int64_t latMaxNs;             // wake-up deadline
+} acq_sched_s;
+
+/* Configuration requests of client handlers to acquisition worker,
+ * which alone writes INA219 registers. Only the latest request
+ * counts, access it between acqConfBegin() and acqConfEnd() */
+typedef struct acq_mbox {
+  pthread_mutex_t mutex;        // Robust and process-shared
+  uint32_t reqSeq;              // Incremented with every request
+  ina_conf_s conf;              // Latest requested configuration
+} acq_mbox_s;
+
+/* Shared state of one INA219 (channel), written only by acquisition
+ * worker of its bus and read by every client handler. Access sample
+ * only through acqPublish() and acqSnapshot(), "lock" is a seqlock
+ * sequence which is odd while writer is updating the sample. Mailbox
+ * is the only part clients write to */
+typedef struct acq_chan {
+  uint32_t lock;
+  acq_sample_s sample;
+  long periodUs;                // Conversion period loop samples at
+  acq_sched_s sched;
+  acq_mbox_s mbox;
+} acq_chan_s;
+
+// Shared memory block of all channels
+typedef struct acq_shared {
+  int nchan;
+  acq_chan_s chan[ACQ_MAX_CHAN];
+  stats_chan_s *stats;          // nchan statistics, own shared mapping
+  trig_chan_s *trig;            // nchan triggers, own shared mapping
+  hist_chan_s *hist;            // nchan histories, own shared mapping
+  energy_tab_s energy;          // Named accumulators over the totals
+} acq_shared_s;
+
+/* One INA219 as given on command line, channel number is its index
+ * in the list. Devices with the same bus path share one worker */
+typedef struct acq_dev {
+  char *busPath;                // i2c device file, e.g. /dev/i2c-1
+  int addr;                     // Slave address
+  ina_bus_s bus;                // Opened by inaBusOpen() for addr
+  ina_conf_s conf;              // Already written in INA219
+  ring_hdr_s *ring;             // Ring samples go to, may be NULL
+} acq_dev_s;
+
+/************** Global Functions Prototype Declarations *********/
+
+acq_shared_s *acqCreate(int nchan);
+int acqStart(acq_shared_s *shm, acq_dev_s *devs, pid_t *pids);
+void acqPublish(acq_chan_s *chan, const acq_sample_s *smp);
+void acqSnapshot(acq_chan_s *chan, acq_sample_s *smp);
+long acqConvPeriodUs(short confRegVal);
+ina_conf_s *acqConfBegin(acq_chan_s *chan);
+void acqConfEnd(acq_chan_s *chan, int post);
+int64_t acqShuntUv(const acq_sample_s *smp);
+int64_t acqVoltageUv(const acq_sample_s *smp);
+int64_t acqCurrentUa(const acq_sample_s *smp);
+double acqShuntMv(const acq_sample_s *smp);
+double acqVoltage(const acq_sample_s *smp);
+double acqCurrent(const acq_sample_s *smp);
+double acqPower(const acq_sample_s *smp);
+long long acqNowNs(void);
+int64_t acqWallNs(const acq_sample_s *smp);
+int acqFresh(const acq_sample_s *smp);
+
+#endif // INAACQ_H
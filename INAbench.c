@@ -0,0 +1,560 @@
+/*****************************************************************
+ * Title    : INAbench.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Load generator and latency benchmark of INA219
+ *            server. Opens N connections to port 2500, sends mix
+ *            of commands at open-loop rate and reports throughput
+ *            and latency histograms, also as JSON file
+ * Version  : 1.0
+ * Options  : [-h host] [-p port] [-n conns] [-r rate] [-t secs]
+ *            [-w warmup-secs] [-m "cmd:weight,..."] [-o result.json]
+ *            [-g p99-limit-us]
+ ****************************************************************/
+
+/* Requests are sent at fixed rate whether replies came or not (open
+ * loop), latency runs from the time request was due, not from the
+ * time it went out, so a stalled server is not hidden by the client
+ * waiting for it (coordinated omission). Replies are JSON, one is
+ * complete when its braces are balanced, so the server must stay in
+ * "proto json". Build: gcc INAbench.c -o INAbench -lm, linked with
+ * the same error_functions and get_num as the server */
+
+/************************** Includes ****************************/
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/get_num.h"
+#include "../header/error_functions.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+#define USAGE "%s [-h host] [-p port] [-n conns] [-r rate-per-s] [-t secs]\n" \
+  "\t[-w warmup-secs] [-m \"cmd:weight,...\"] [-o result.json] [-g p99-limit-us]\n"
+
+#define BENCH_MAX_CMDS   16
+#define BENCH_CMD_SIZE   64
+#define BENCH_INFLIGHT   256             // Requests one connection may owe
+#define BENCH_WBUF       4096
+#define BENCH_RBUF       4096
+#define BENCH_DRAIN_NS   2000000000LL    // Wait for late replies at end
+
+/* Log-linear histogram, values below 2 * HDR_SUB are exact, above it
+ * every power of two has HDR_SUB buckets, so error is below 1/64.
+ * Values are ns, up to 2^40 (18 minutes) */
+#define HDR_SUB_BITS     6
+#define HDR_SUB          (1 << HDR_SUB_BITS)
+#define HDR_BUCKETS      ((40 - HDR_SUB_BITS + 1) * HDR_SUB)
+
+/**************** New Local Types Definitions *******************/
+
+typedef struct hdr {
+  uint64_t count[HDR_BUCKETS];
+  uint64_t total;
+  int64_t max;
+} hdr_s;
+
+// Command of the mix, picked with probability weight / sum of weights
+typedef struct bench_cmd {
+  char text[BENCH_CMD_SIZE];
+  int weight;
+  hdr_s lat;
+  uint64_t errors;
+} bench_cmd_s;
+
+typedef struct bench_conn {
+  int fd;
+  int open;                     // Connected, requests may go
+  int64_t connNs;               // connect() started
+  int64_t nextNs;               // Next request is due
+  int64_t dueNs[BENCH_INFLIGHT];        // Requests waiting for reply,
+  unsigned char cmd[BENCH_INFLIGHT];    // FIFO, server replies in order
+  int head, queued;
+  char wbuf[BENCH_WBUF];        // Requests not written yet
+  int wlen;
+  char reply[BENCH_RBUF];       // Start of reply being received
+  int rlen;
+  int depth, inStr, esc;        // JSON brace state of reply
+} bench_conn_s;
+
+/************ Static global Variable Definitions ****************/
+
+static bench_cmd_s cmds[BENCH_MAX_CMDS];
+static int ncmd, weightSum;
+static hdr_s latAll, connLat;
+static uint64_t sent, replies, errors, overruns;
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static void mixParse(char *mix);
+static int64_t nowNs(void);
+static void connStart(bench_conn_s *c, struct sockaddr_in *sa);
+static void connQueue(bench_conn_s *c, int64_t dueNs, int record);
+static void connFlush(bench_conn_s *c);
+static void connRead(bench_conn_s *c, int64_t measureFromNs);
+static void replyDone(bench_conn_s *c, int64_t measureFromNs);
+static void hdrAdd(hdr_s *h, int64_t v);
+static int64_t hdrValue(int idx);
+static int64_t hdrPercentile(const hdr_s *h, double pct);
+static void hdrJson(FILE *fp, const hdr_s *h, int buckets);
+static void report(FILE *fp, double secs, int nconn, double rate, int64_t allConnNs);
+
+/*********************** Main Function **************************/
+int main(int argc, char *argv[])
+{
+  const char *host = "127.0.0.1", *outPath = NULL;
+  char mixDef[] = "voltage:8,current:1,log:1";
+  char *mix = mixDef;
+  int port = 2500, nconn = 16, opt, i, n, opened = 0;
+  double rate = 1000, secs = 10, warmup = 1, p99Limit = 0;
+  struct sockaddr_in sa;
+  struct addrinfo hints, *ai;
+  struct epoll_event ev, evs[256];
+  struct itimerspec its;
+  bench_conn_s *conn, *c;
+  int64_t t0, startNs, endNs, measureNs, now, next, allConnNs = 0;
+  int epfd, tfd, s;
+  FILE *fp;
+
+  while ((opt = getopt(argc, argv, "h:p:n:r:t:w:m:o:g:")) != -1) {
+    switch (opt) {
+    case 'h': host = optarg; break;
+    case 'p': port = getInt(optarg, GN_GT_0, "port"); break;
+    case 'n': nconn = getInt(optarg, GN_GT_0, "conns"); break;
+    case 'r': rate = atof(optarg); break;
+    case 't': secs = atof(optarg); break;
+    case 'w': warmup = atof(optarg); break;
+    case 'm': mix = optarg; break;
+    case 'o': outPath = optarg; break;
+    case 'g': p99Limit = atof(optarg); break;
+    default: usageErr(USAGE, argv[0]);
+    }
+  }
+  if (optind != argc || !(rate > 0) || !(secs > 0) || warmup < 0)
+    usageErr(USAGE, argv[0]);
+  mixParse(mix);
+
+  memset(&hints, 0, sizeof hints);
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  s = getaddrinfo(host, NULL, &hints, &ai);
+  if (s != 0)
+    fatal("getaddrinfo(%s): %s", host, gai_strerror(s));
+  memcpy(&sa, ai->ai_addr, sizeof sa);
+  sa.sin_port = htons(port);
+  freeaddrinfo(ai);
+
+  conn = calloc(nconn, sizeof(bench_conn_s));
+  if (conn == NULL)
+    errExit("calloc(bench_conn_s)");
+
+  epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd == -1)
+    errExit("epoll_create1");
+  tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  if (tfd == -1)
+    errExit("timerfd_create");
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) == -1)
+    errExit("epoll_ctl(timerfd)");
+
+  // All connections at once, how fast server takes them is measured
+  t0 = nowNs();
+  for (i = 0; i < nconn; i++) {
+    connStart(&conn[i], &sa);
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    ev.data.ptr = &conn[i];
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, conn[i].fd, &ev) == -1)
+      errExit("epoll_ctl(conn)");
+  }
+
+  // Every connection sends rate / nconn requests a second, phases spread
+  startNs = nowNs();
+  measureNs = startNs + (int64_t)(warmup * 1e9);
+  endNs = measureNs + (int64_t)(secs * 1e9);
+  for (i = 0; i < nconn; i++)
+    conn[i].nextNs = startNs + (int64_t)(1e9 * nconn / rate * i / nconn);
+
+  for (;;) {
+    now = nowNs();
+    if (now >= endNs + BENCH_DRAIN_NS)
+      break;
+
+    next = endNs + BENCH_DRAIN_NS;
+    for (i = 0, n = 0; i < nconn; i++) {
+      c = &conn[i];
+      n += c->queued;
+      if (!c->open || c->fd == -1)
+	continue;
+      for (; c->nextNs <= now && c->nextNs < endNs;
+	   c->nextNs += (int64_t)(1e9 * nconn / rate))
+	connQueue(c, c->nextNs, c->nextNs >= measureNs);
+      connFlush(c);
+      if (c->nextNs < endNs && c->nextNs < next)
+	next = c->nextNs;
+    }
+    if (now >= endNs && n == 0)
+      break;
+
+    memset(&its, 0, sizeof its);
+    its.it_value.tv_sec = next / 1000000000LL;
+    its.it_value.tv_nsec = next % 1000000000LL;
+    if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) == -1)
+      errExit("timerfd_settime");
+
+    n = epoll_wait(epfd, evs, 256, -1);
+    if (n == -1) {
+      if (errno == EINTR)
+	continue;
+      errExit("epoll_wait");
+    }
+
+    for (i = 0; i < n; i++) {
+      c = evs[i].data.ptr;
+      if (c == NULL) {
+	uint64_t exp;
+	if (read(tfd, &exp, sizeof exp) == -1 && errno != EAGAIN)
+	  errExit("read(timerfd)");
+	continue;
+      }
+
+      if (!c->open && (evs[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+	socklen_t len = sizeof s;
+	if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &s, &len) == -1 || s != 0) {
+	  errno = s;
+	  errMsg("connect(%s:%d)", host, port);
+	  close(c->fd);
+	  c->fd = -1;
+	  continue;
+	}
+	c->open = 1;
+	hdrAdd(&connLat, nowNs() - c->connNs);
+	if (++opened == nconn)
+	  allConnNs = nowNs() - t0;
+      }
+      if (evs[i].events & EPOLLIN)
+	connRead(c, measureNs);
+      if (c->fd != -1 && (evs[i].events & EPOLLOUT))
+	connFlush(c);
+    }
+  }
+
+  for (i = 0; i < nconn; i++)
+    if (conn[i].fd != -1) {
+      errors += conn[i].queued;
+      close(conn[i].fd);
+    }
+
+  report(stdout, secs, nconn, rate, allConnNs);
+  if (outPath != NULL) {
+    fp = fopen(outPath, "w");
+    if (fp == NULL)
+      errExit("fopen(%s)", outPath);
+    report(fp, secs, nconn, rate, allConnNs);
+    if (fclose(fp) == EOF)
+      errExit("fclose(%s)", outPath);
+  }
+
+  // Regression gate, p99 over limit or any failed request
+  if (p99Limit > 0 &&
+      (errors || latAll.total == 0 || hdrPercentile(&latAll, 99) / 1e3 > p99Limit))
+    exit(EXIT_FAILURE);
+
+  exit(EXIT_SUCCESS);
+}
+
+/***************** Local Functions Definitions ******************/
+
+// "cmd:weight,cmd:weight", weight defaults to 1
+static void mixParse(char *mix)
+{
+  char *item, *save, *colon;
+
+  for (item = strtok_r(mix, ",", &save); item != NULL;
+       item = strtok_r(NULL, ",", &save)) {
+    if (ncmd == BENCH_MAX_CMDS)
+      cmdLineErr("-m: at most %d commands\n", BENCH_MAX_CMDS);
+
+    colon = strrchr(item, ':');
+    if (colon != NULL)
+      *colon++ = '\0';
+    if (item[0] == '\0' || strlen(item) >= BENCH_CMD_SIZE - 1)
+      cmdLineErr("-m: bad command '%s'\n", item);
+
+    snprintf(cmds[ncmd].text, BENCH_CMD_SIZE, "%s\n", item);
+    cmds[ncmd].weight = (colon != NULL) ? getInt(colon, GN_GT_0, "weight") : 1;
+    weightSum += cmds[ncmd].weight;
+    ncmd++;
+  }
+  if (ncmd == 0)
+    cmdLineErr("-m: no command\n");
+}
+
+static int64_t nowNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void connStart(bench_conn_s *c, struct sockaddr_in *sa)
+{
+  int optval = 1;
+
+  c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (c->fd == -1)
+    errExit("socket(2)");
+
+  // Requests are tiny, Nagle would hold them for the previous reply
+  if (setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof optval) == -1)
+    errExit("setsockopt(TCP_NODELAY)");
+
+  c->connNs = nowNs();
+  if (connect(c->fd, (struct sockaddr *)sa, sizeof *sa) == -1 &&
+      errno != EINPROGRESS)
+    errExit("connect(2)");
+}
+
+/* Put request due at dueNs in write buffer. When server owes too
+ * many replies request is not sent and counted as overrun. record
+ * tells whether it is past warm-up */
+static void connQueue(bench_conn_s *c, int64_t dueNs, int record)
+{
+  bench_cmd_s *cmd;
+  int pick, k, len;
+
+  pick = rand() % weightSum;
+  for (k = 0; pick >= cmds[k].weight; k++)
+    pick -= cmds[k].weight;
+  cmd = &cmds[k];
+
+  len = strlen(cmd->text);
+  if (c->queued == BENCH_INFLIGHT || c->wlen + len > BENCH_WBUF) {
+    if (record)
+      overruns++;
+    return;
+  }
+
+  memcpy(c->wbuf + c->wlen, cmd->text, len);
+  c->wlen += len;
+  c->dueNs[(c->head + c->queued) % BENCH_INFLIGHT] = dueNs;
+  c->cmd[(c->head + c->queued) % BENCH_INFLIGHT] = k;
+  c->queued++;
+  if (record)
+    sent++;
+}
+
+static void connFlush(bench_conn_s *c)
+{
+  ssize_t n;
+
+  if (c->wlen == 0 || !c->open)
+    return;
+
+  n = write(c->fd, c->wbuf, c->wlen);
+  if (n == -1) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+      errExit("write(conn)");
+    return;
+  }
+
+  memmove(c->wbuf, c->wbuf + n, c->wlen - n);
+  c->wlen -= n;
+}
+
+/* Take replies out of socket. Reply ends where its top-level braces
+ * close, text between replies (";\n") is skipped */
+static void connRead(bench_conn_s *c, int64_t measureFromNs)
+{
+  char buf[BENCH_RBUF], ch;
+  ssize_t n, j;
+
+  for (;;) {
+    n = read(c->fd, buf, sizeof buf);
+    if (n == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+	return;
+      errExit("read(conn)");
+    }
+    if (n == 0) {
+      errMsg("server closed connection, %d replies lost", c->queued);
+      errors += c->queued;
+      c->queued = 0;
+      close(c->fd);
+      c->fd = -1;
+      c->open = 0;
+      return;
+    }
+
+    for (j = 0; j < n; j++) {
+      ch = buf[j];
+      if (c->depth == 0 && ch != '{')
+	continue;
+
+      if (c->rlen < BENCH_RBUF - 1)
+	c->reply[c->rlen++] = ch;
+
+      if (c->inStr) {
+	if (c->esc)
+	  c->esc = 0;
+	else if (ch == '\\')
+	  c->esc = 1;
+	else if (ch == '"')
+	  c->inStr = 0;
+      }
+      else if (ch == '"')
+	c->inStr = 1;
+      else if (ch == '{')
+	c->depth++;
+      else if (ch == '}' && --c->depth == 0)
+	replyDone(c, measureFromNs);
+    }
+  }
+}
+
+static void replyDone(bench_conn_s *c, int64_t measureFromNs)
+{
+  bench_cmd_s *cmd;
+  int64_t dueNs, lat;
+
+  c->reply[c->rlen] = '\0';
+  c->rlen = 0;
+
+  if (c->queued == 0) {
+    errMsg("reply nobody asked for: %.64s", c->reply);
+    return;
+  }
+
+  dueNs = c->dueNs[c->head];
+  cmd = &cmds[c->cmd[c->head]];
+  c->head = (c->head + 1) % BENCH_INFLIGHT;
+  c->queued--;
+
+  if (dueNs < measureFromNs)
+    return;
+
+  replies++;
+  if (strstr(c->reply, "\"ERROR\"") != NULL || strstr(c->reply, "\"WARN\"") != NULL) {
+    errors++;
+    cmd->errors++;
+  }
+
+  lat = nowNs() - dueNs;
+  hdrAdd(&latAll, lat);
+  hdrAdd(&cmd->lat, lat);
+}
+
+static void hdrAdd(hdr_s *h, int64_t v)
+{
+  int e, idx;
+
+  if (v < 0)
+    v = 0;
+
+  if (v < 2 * HDR_SUB)
+    idx = v;
+  else {
+    e = 63 - __builtin_clzll(v) - HDR_SUB_BITS;
+    idx = (e + 1) * HDR_SUB + (int)((v >> e) - HDR_SUB);
+    if (idx >= HDR_BUCKETS)
+      idx = HDR_BUCKETS - 1;
+  }
+
+  h->count[idx]++;
+  h->total++;
+  if (v > h->max)
+    h->max = v;
+}
+
+// Highest value bucket idx holds
+static int64_t hdrValue(int idx)
+{
+  int e;
+
+  if (idx < 2 * HDR_SUB)
+    return idx;
+
+  e = idx / HDR_SUB - 1;
+  return (((int64_t)(idx % HDR_SUB + HDR_SUB) + 1) << e) - 1;
+}
+
+static int64_t hdrPercentile(const hdr_s *h, double pct)
+{
+  uint64_t want, seen = 0;
+  int idx;
+
+  if (h->total == 0)
+    return 0;
+
+  want = (uint64_t)ceil(h->total * pct / 100.0);
+  if (want == 0)
+    want = 1;
+  for (idx = 0; idx < HDR_BUCKETS; idx++) {
+    seen += h->count[idx];
+    if (seen >= want)
+      return (hdrValue(idx) < h->max) ? hdrValue(idx) : h->max;
+  }
+
+  return h->max;
+}
+
+/* Percentiles in us, with non-empty buckets as [value-us, count]
+ * pairs when "buckets" is set */
+static void hdrJson(FILE *fp, const hdr_s *h, int buckets)
+{
+  static const double pcts[] = { 50, 90, 99, 99.9, 99.99 };
+  static const char *names[] = { "p50", "p90", "p99", "p99.9", "p99.99" };
+  int k, idx, first = 1;
+
+  fprintf(fp, "{ \"count\":%llu", (unsigned long long)h->total);
+  for (k = 0; k < 5; k++)
+    fprintf(fp, ", \"%s\":%.1f", names[k], hdrPercentile(h, pcts[k]) / 1e3);
+  fprintf(fp, ", \"max\":%.1f", h->max / 1e3);
+
+  if (buckets) {
+    fprintf(fp, ", \"histogram_us\":[");
+    for (idx = 0; idx < HDR_BUCKETS; idx++)
+      if (h->count[idx]) {
+	fprintf(fp, "%s[%.3f,%llu]", first ? "" : ",", hdrValue(idx) / 1e3,
+		(unsigned long long)h->count[idx]);
+	first = 0;
+      }
+    fprintf(fp, "]");
+  }
+  fprintf(fp, " }");
+}
+
+static void report(FILE *fp, double secs, int nconn, double rate, int64_t allConnNs)
+{
+  int k;
+
+  fprintf(fp, "{ \"conns\":%d, \"rate\":%g, \"secs\":%g,\n", nconn, rate, secs);
+  fprintf(fp, "  \"sent\":%llu, \"replies\":%llu, \"errors\":%llu, \"overruns\":%llu,\n",
+	  (unsigned long long)sent, (unsigned long long)replies,
+	  (unsigned long long)errors, (unsigned long long)overruns);
+  fprintf(fp, "  \"throughput_rps\":%.1f, \"all_connected_ms\":%.3f,\n",
+	  replies / secs, allConnNs / 1e6);
+  fprintf(fp, "  \"connect_us\":");
+  hdrJson(fp, &connLat, 0);
+  fprintf(fp, ",\n  \"latency_us\":");
+  hdrJson(fp, &latAll, fp != stdout);
+  fprintf(fp, ",\n  \"commands\":{");
+  for (k = 0; k < ncmd; k++) {
+    fprintf(fp, "%s\n    \"%.*s\":{ \"errors\":%llu, \"latency_us\":", k ? "," : "",
+	    (int)strlen(cmds[k].text) - 1, cmds[k].text,
+	    (unsigned long long)cmds[k].errors);
+    hdrJson(fp, &cmds[k].lat, 0);
+    fprintf(fp, " }");
+  }
+  fprintf(fp, " } }\n");
+}
@@ -0,0 +1,73 @@
+/*****************************************************************
+ * Title    : INAbin.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Encoding of binary frames described in INAbin.h.
+ *            Fields are stored byte by byte, so frames are
+ *            little-endian regardless of host byte order
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <stdint.h>
+#include "INAacq.h"
+#include "INAbin.h"
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static void put16(char *p, uint16_t v);
+static void put32(char *p, uint32_t v);
+static void put64(char *p, uint64_t v);
+
+/**************** Global Functions Definitions ******************/
+
+// Put sample frame of channel ch in buf, returns its length
+size_t binSample(char *buf, const acq_sample_s *smp, int ch)
+{
+  buf[0] = (char)BIN_MAGIC;
+  buf[1] = BIN_SAMPLE;
+  put16(buf + 2, BIN_SAMPLE_SIZE);
+  put32(buf + 4, smp->seq);
+  put64(buf + 8, (uint64_t)acqWallNs(smp));
+  put16(buf + 16, (uint16_t)smp->shuntRegVal);
+  put16(buf + 18, (uint16_t)smp->busRegVal);
+  put16(buf + 20, (uint16_t)smp->currRegVal);
+  put16(buf + 22, (uint16_t)smp->powerRegVal);
+  buf[24] = ch;
+  buf[25] = smp->err & (ACQ_ERR_SHUNT | ACQ_ERR_BUS | ACQ_ERR_CURR | ACQ_ERR_POWER);
+  buf[26] = buf[27] = 0;
+  put64(buf + 28, (uint64_t)smp->conf.currLsbPa);
+
+  return BIN_SAMPLE_SIZE;
+}
+
+/* Wrap text of textLen bytes already placed at buf + BIN_HDR_SIZE
+ * into text frame, returns frame length */
+size_t binText(char *buf, size_t textLen)
+{
+  buf[0] = (char)BIN_MAGIC;
+  buf[1] = BIN_TEXT;
+  put16(buf + 2, (uint16_t)(textLen + BIN_HDR_SIZE));
+
+  return textLen + BIN_HDR_SIZE;
+}
+
+/***************** Local Functions Definitions ******************/
+
+static void put16(char *p, uint16_t v)
+{
+  p[0] = v & 0xff;
+  p[1] = v >> 8;
+}
+
+static void put32(char *p, uint32_t v)
+{
+  put16(p, v & 0xffff);
+  put16(p + 2, v >> 16);
+}
+
+static void put64(char *p, uint64_t v)
+{
+  put32(p, v & 0xffffffff);
+  put32(p + 4, v >> 32);
+}
@@ -0,0 +1,57 @@
+/*****************************************************************
+ * Title    : INAbin.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Compact binary framing of INA219 server replies,
+ *            switched on per connection by "proto binary"
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INABIN_H
+#define INABIN_H
+
+/* Every frame starts with 4 byte header, all fields little-endian:
+ *
+ *   offset size
+ *     0     1   magic     BIN_MAGIC
+ *     1     1   type      BIN_SAMPLE or BIN_TEXT
+ *     2     2   length    whole frame length including header
+ *
+ * BIN_SAMPLE frame, 36 bytes, raw register values of one sample:
+ *
+ *     4     4   seq       sample sequence number
+ *     8     8   time      sample time, ns since Epoch (UTC)
+ *    16     2   shunt     shunt voltage register, signed
+ *    18     2   bus       bus voltage register (CNVR, OVF in bits 1, 0),
+ *                         CNVR clear marks stale sample
+ *    20     2   current   current register, signed
+ *    22     2   power     power register
+ *    24     1   channel   INA219 device the sample is of
+ *    25     1   err       ACQ_ERR_* bits of registers failed to read,
+ *                         their values are stale
+ *    26     2   reserved  zero
+ *    28     8   currLsb   current register LSB in pA the sample was
+ *                         taken with, power LSB is 20 times it
+ *
+ * BIN_TEXT frame carries one JSON reply (INFO, WARN, ERROR) as text.
+ * Scale of shunt and bus registers is told in INFO reply of
+ * "proto binary", it never changes */
+
+/************************** Includes ****************************/
+#include <stddef.h>
+#include "INAacq.h"
+
+/************ Global Symbolic Constant Definitions **************/
+
+#define BIN_MAGIC        0xA9
+#define BIN_SAMPLE       1
+#define BIN_TEXT         2
+
+#define BIN_HDR_SIZE     4
+#define BIN_SAMPLE_SIZE  36
+
+/************** Global Functions Prototype Declarations *********/
+
+size_t binSample(char *buf, const acq_sample_s *smp, int ch);
+size_t binText(char *buf, size_t textLen);
+
+#endif // INABIN_H
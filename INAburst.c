@@ -0,0 +1,235 @@
+/*****************************************************************
+ * Title    : INAburst.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Device backend of real i2c adapter and dispatch of
+ *            register access to backend of the bus. Coherent read
+ *            of shunt, bus, power and current registers of INA219
+ *            puts all four pointer writes and reads in one I2C_RDWR
+ *            transfer with repeated starts, adapters without plain
+ *            i2c support fall back to register by register reads
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/INA219.h"
+#include "../../rpi_programming/i2c/header/i2c.h"
+#include "INAburst.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+#define BURST_REGS  4
+
+/************ Static global Variable Definitions ****************/
+
+// Registers in the order of INA219 register map
+static const unsigned char burstReg[BURST_REGS] = {
+  shunt_volt_reg, bus_volt_reg, power_data_reg, curr_data_reg
+};
+
+static const int burstErr[BURST_REGS] = {
+  BURST_SHUNT, BURST_BUS, BURST_POWER, BURST_CURR
+};
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static int i2cRegRead(ina_bus_s *bus, unsigned char reg, short *val);
+static int i2cRegWrite(ina_bus_s *bus, unsigned char reg, short val);
+static int i2cBurstRead(ina_bus_s *bus, ina_burst_s *regs);
+static void i2cClose(ina_bus_s *bus);
+static void burstStore(ina_burst_s *regs, int idx, char *RDbuf);
+static long long opStart(ina_bus_s *bus);
+static void opEnd(ina_bus_s *bus, int op, long long t0);
+
+/************ Static global Variable Definitions ****************/
+
+static const ina_ops_s i2cOps = {
+  i2cRegRead, i2cRegWrite, i2cBurstRead, i2cClose
+};
+
+/**************** Global Functions Definitions ******************/
+
+/* Open INA219 at addr on bus "path", which is i2c device file unless
+ * it is claimed by one of backends, terminated by NULL prefix. Returns
+ * -1 with reason in err if backend fails, i2c_init() exits on its own
+ * failure. Access is not timed until caller sets bus->timing */
+int inaBusOpen(ina_bus_s *bus, const char *path, int addr,
+	       const ina_backend_s *backends, char *err, size_t errSize)
+{
+  size_t len;
+
+  bus->timing = NULL;
+
+  for (; backends != NULL && backends->prefix != NULL; backends++) {
+    len = strlen(backends->prefix);
+    if (strncmp(path, backends->prefix, len) == 0 &&
+	(path[len] == '\0' || path[len] == ','))
+      return backends->open(bus, path, addr, err, errSize);
+  }
+
+  inaBusInit(bus, i2c_init((char *)path, addr), addr);
+  return 0;
+}
+
+/* Real i2c backend on already opened i2c_init() descriptor. Find out
+ * once, whether adapter can do combined transfers, so the sampling
+ * path does not have to ask every time */
+void inaBusInit(ina_bus_s *bus, int i2cfd, int addr)
+{
+  unsigned long funcs = 0;
+
+  bus->ops = &i2cOps;
+  bus->fd = i2cfd;
+  bus->addr = addr;
+  bus->rdwr = ioctl(i2cfd, I2C_FUNCS, &funcs) == 0 && (funcs & I2C_FUNC_I2C);
+  bus->dev = NULL;
+  bus->timing = NULL;
+}
+
+void inaBusClose(ina_bus_s *bus)
+{
+  bus->ops->close(bus);
+}
+
+// Read one register, -1 on failure
+int inaRegRead(ina_bus_s *bus, unsigned char reg, short *val)
+{
+  long long t0 = opStart(bus);
+  int ret;
+
+  ret = bus->ops->regRead(bus, reg, val);
+  opEnd(bus, INA_OP_READ, t0);
+  return ret;
+}
+
+// Write one register, -1 on failure
+int inaRegWrite(ina_bus_s *bus, unsigned char reg, short val)
+{
+  long long t0 = opStart(bus);
+  int ret;
+
+  ret = bus->ops->regWrite(bus, reg, val);
+  opEnd(bus, INA_OP_WRITE, t0);
+  return ret;
+}
+
+/* Read shunt, bus, power and current register into regs.
+ * Returns BURST_* bits of registers which failed to read, 0 if all
+ * were read */
+int inaBurstRead(ina_bus_s *bus, ina_burst_s *regs)
+{
+  long long t0 = opStart(bus);
+  int ret;
+
+  ret = bus->ops->burstRead(bus, regs);
+  opEnd(bus, INA_OP_BURST, t0);
+  return ret;
+}
+
+/***************** Local Functions Definitions ******************/
+
+static int i2cRegRead(ina_bus_s *bus, unsigned char reg, short *val)
+{
+  char RDbuf[I2C_BUF_SIZE];
+
+  if (i2c_read_data_word(bus->fd, &reg, RDbuf) == -1)
+    return -1;
+
+  strtosh(RDbuf, *val)
+  return 0;
+}
+
+static int i2cRegWrite(ina_bus_s *bus, unsigned char reg, short val)
+{
+  return (i2c_write_data_word(bus->fd, &reg, val) == -1) ? -1 : 0;
+}
+
+static int i2cBurstRead(ina_bus_s *bus, ina_burst_s *regs)
+{
+  struct i2c_msg msgs[2 * BURST_REGS];
+  struct i2c_rdwr_ioctl_data xfer;
+  unsigned char ptr[BURST_REGS];
+  char RDbuf[BURST_REGS][2];
+  int err = 0;
+  int j;
+
+  if (bus->rdwr) {
+    // Pointer write followed by 2 byte read for each register
+    for (j = 0; j < BURST_REGS; j++) {
+      ptr[j] = burstReg[j];
+
+      msgs[2 * j].addr = bus->addr;
+      msgs[2 * j].flags = 0;
+      msgs[2 * j].len = 1;
+      msgs[2 * j].buf = &ptr[j];
+
+      msgs[2 * j + 1].addr = bus->addr;
+      msgs[2 * j + 1].flags = I2C_M_RD;
+      msgs[2 * j + 1].len = 2;
+      msgs[2 * j + 1].buf = (unsigned char *)RDbuf[j];
+    }
+
+    xfer.msgs = msgs;
+    xfer.nmsgs = 2 * BURST_REGS;
+
+    if (ioctl(bus->fd, I2C_RDWR, &xfer) == -1)
+      return BURST_ALL;
+
+    for (j = 0; j < BURST_REGS; j++)
+      burstStore(regs, j, RDbuf[j]);
+
+    return 0;
+  }
+
+  // Generic fallback, the same reads as the rest of server does
+  for (j = 0; j < BURST_REGS; j++) {
+    ptr[j] = burstReg[j];
+
+    if (i2c_read_data_word(bus->fd, &ptr[j], RDbuf[j]) == -1)
+      err |= burstErr[j];
+    else
+      burstStore(regs, j, RDbuf[j]);
+  }
+
+  return err;
+}
+
+static void i2cClose(ina_bus_s *bus)
+{
+  if (close(bus->fd) == -1)
+    errExit("close(i2cfd)");
+}
+
+static void burstStore(ina_burst_s *regs, int idx, char *RDbuf)
+{
+  switch (idx) {
+  case 0:
+    strtosh(RDbuf, regs->shuntRegVal)
+    break;
+  case 1:
+    strtosh(RDbuf, regs->busRegVal)
+    break;
+  case 2:
+    strtosh(RDbuf, regs->powerRegVal)
+    break;
+  default:
+    strtosh(RDbuf, regs->currRegVal)
+    break;
+  }
+}
+
+// Start of timed access, 0 if bus is not timed
+static long long opStart(ina_bus_s *bus)
+{
+  return (bus->timing != NULL) ? bus->timing->now() : 0;
+}
+
+static void opEnd(ina_bus_s *bus, int op, long long t0)
+{
+  if (bus->timing != NULL)
+    bus->timing->observe(op, bus->timing->now() - t0);
+}
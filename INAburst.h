@@ -0,0 +1,88 @@
+/*****************************************************************
+ * Title    : INAburst.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Access to INA219 through pluggable device backend,
+ *            real i2c adapter or one the caller brings along, e.g.
+ *            simulated device (INAsim.h), and coherent read of all
+ *            measurement registers in one combined i2c transfer.
+ *            Needs nothing but i2c library, so it links alone
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INABURST_H
+#define INABURST_H
+
+/************************** Includes ****************************/
+#include <stddef.h>
+
+/************ Global Symbolic Constant Definitions **************/
+
+// Bits returned by inaBurstRead(), one per register failed to read
+#define BURST_SHUNT  0x01
+#define BURST_BUS    0x02
+#define BURST_CURR   0x04
+#define BURST_POWER  0x08
+#define BURST_ALL    (BURST_SHUNT | BURST_BUS | BURST_CURR | BURST_POWER)
+
+// Register access timed by ina_timing_s hook
+#define INA_OP_READ   0
+#define INA_OP_WRITE  1
+#define INA_OP_BURST  2
+
+/**************** New Global Types Definitions ******************/
+
+// Raw snapshot of measurement registers
+typedef struct ina_burst {
+  short shuntRegVal;
+  short busRegVal;
+  short powerRegVal;
+  short currRegVal;
+} ina_burst_s;
+
+struct ina_bus;
+
+/* Device backend. Register access returns -1 and sets errno on
+ * failure, burst read returns BURST_* bits like inaBurstRead() */
+typedef struct ina_ops {
+  int (*regRead)(struct ina_bus *bus, unsigned char reg, short *val);
+  int (*regWrite)(struct ina_bus *bus, unsigned char reg, short val);
+  int (*burstRead)(struct ina_bus *bus, ina_burst_s *regs);
+  void (*close)(struct ina_bus *bus);
+} ina_ops_s;
+
+/* Backend selected by bus path starting with prefix, followed by
+ * end of path or ','. Open works as inaBusOpen() */
+typedef struct ina_backend {
+  const char *prefix;
+  int (*open)(struct ina_bus *bus, const char *spec, int addr, char *err,
+	      size_t errSize);
+} ina_backend_s;
+
+/* Timing of register access, now() is clock in ns, observe() gets
+ * INA_OP_* and how long it took */
+typedef struct ina_timing {
+  long long (*now)(void);
+  void (*observe)(int op, long long ns);
+} ina_timing_s;
+
+// INA219 on i2c bus, filled by inaBusOpen() or inaBusInit()
+typedef struct ina_bus {
+  const ina_ops_s *ops;
+  int fd;                       // Opened by i2c_init(), -1 if simulated
+  int addr;                     // Slave address
+  int rdwr;                     // Adapter supports combined transfers
+  void *dev;                    // Backend state of simulated device
+  const ina_timing_s *timing;   // NULL when access is not timed
+} ina_bus_s;
+
+/************** Global Functions Prototype Declarations *********/
+
+int inaBusOpen(ina_bus_s *bus, const char *path, int addr,
+	       const ina_backend_s *backends, char *err, size_t errSize);
+void inaBusInit(ina_bus_s *bus, int i2cfd, int addr);
+void inaBusClose(ina_bus_s *bus);
+int inaRegRead(ina_bus_s *bus, unsigned char reg, short *val);
+int inaRegWrite(ina_bus_s *bus, unsigned char reg, short val);
+int inaBurstRead(ina_bus_s *bus, ina_burst_s *regs);
+
+#endif // INABURST_H
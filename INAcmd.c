@@ -0,0 +1,1359 @@
+/*****************************************************************
+ * Title    : INAcmd.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Client command set of INA219 server. Takes one
+ *            command line and formats reply into a buffer, so it
+ *            can be used with both stdio streams and event loop
+ * Version  : 1.0
+ ****************************************************************/
+#define JSON
+
+/************************** Includes ****************************/
+#include <stdarg.h>
+#include <ctype.h>
+#include <time.h>
+#include <math.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/INA219.h"
+#include "INAacq.h"
+#include "INAconf.h"
+#include "INAbin.h"
+#include "INAlog.h"
+#include "INAconv.h"
+#include "INAstats.h"
+#include "INAhist.h"
+#include "INAenergy.h"
+#include "INAtrig.h"
+#include "INAmetrics.h"
+#include "INAfmt.h"
+#include "INAcmd.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+#define VALID_CMDS "'voltage', 'current', 'log', 'stats', 'energy', 'stream', 'stop', 'proto', 'config', 'metrics', 'batch', 'trigger', 'history', 'report', 'exit'"
+
+#define CMD_DEFS (int)(sizeof cmdDefs / sizeof cmdDefs[0])
+
+#define TRIG_USAGE "Usage: trigger [channel] [current|voltage above|below|rise|fall " \
+  "<level-A|V> [pre [post]] | read [from [count]] | cancel], pre + post up to %d"
+
+/**************** New Local Types Definitions *******************/
+
+// Command of dispatch table
+typedef struct cmd_def {
+  const char *name;
+  size_t len;                   // strlen(name)
+  int met;                      // MET_CMD_* latency histogram
+  int (*run)(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+} cmd_def_s;
+
+/************ Static global Variable Definitions ****************/
+
+// Sample log directory, NULL if server does not log
+static const char *logDir;
+
+// Names of TRIG_* quantities and conditions, in order of their values
+static const char *trigQuantities[] = { "current", "voltage" };
+static const char *trigEdges[] = { "above", "below", "rise", "fall" };
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static int cmdVoltage(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static int cmdCurrent(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static int cmdLog(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static int cmdMetrics(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static int cmdBatch(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static int cmdStop(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static int cmdExit(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static int cmdUnknown(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static const cmd_def_s *cmdFind(const char *name);
+static void replyf(cmd_sess_s *sess, cmd_reply_s *reply, const char *fmt, ...)
+  __attribute__ ((format (printf, 3, 4)));
+static int sampleCheck(cmd_sess_s *sess, acq_sample_s *smp, int regs,
+		       cmd_reply_s *reply);
+static const char *errText(int err);
+static int chanArg(cmd_sess_s *sess, const char *tok, cmd_reply_s *reply);
+static const char *chanText(cmd_sess_s *sess, int ch);
+static const char *tsText(const acq_sample_s *smp);
+#ifndef JSON
+static double voltage(cmd_sess_s *sess, acq_sample_s *smp);
+#endif // JSON
+static const char *voltText(const acq_sample_s *smp, char *buf);
+static const char *currText(const acq_sample_s *smp, char *buf);
+static int logAll(cmd_sess_s *sess, cmd_reply_s *reply);
+static int logHistory(cmd_sess_s *sess, int ch, const char *fromArg,
+		      const char *countArg, cmd_reply_s *reply);
+static void ringToAcq(const ring_sample_s *rs, acq_sample_s *smp);
+static void historySample(cmd_sess_s *sess, acq_sample_s *smp, int ch, int n,
+			  cmd_reply_s *reply);
+static int statsReply(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static void aggText(const char *name, const stats_agg_s *a, char *buf,
+		    size_t size);
+static int historyCmd(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static int reportCmd(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static void rangeText(const char *name, double min, double max, double sum,
+		      long long n, char *buf, size_t size);
+static int energyCmd(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static void energyText(cmd_sess_s *sess, const energy_acc_s *acc, char *buf,
+		       size_t size);
+static int streamStart(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static int protoSet(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static int configSet(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static int trigCmd(cmd_sess_s *sess, char *args, cmd_reply_s *reply);
+static int trigStatus(cmd_sess_s *sess, int ch, cmd_reply_s *reply);
+static int trigCapture(cmd_sess_s *sess, int ch, char *args, cmd_reply_s *reply);
+static int nameIndex(const char *name, const char **names, int n);
+static void lsbList(cmd_sess_s *sess, double scale, char *buf, size_t size);
+
+/* Dispatch table of commands, most frequent first, after prototypes of
+ * handlers. Handlers take the rest of command line, strtok_r(NULL, ...)
+ * gives their arguments */
+static const cmd_def_s cmdDefs[] = {
+  { "voltage", 7, MET_CMD_VOLTAGE, cmdVoltage },
+  { "current", 7, MET_CMD_CURRENT, cmdCurrent },
+  { "log",     3, MET_CMD_LOG,     cmdLog },
+  { "stats",   5, MET_CMD_STATS,   statsReply },
+  { "energy",  6, MET_CMD_ENERGY,  energyCmd },
+  { "stream",  6, MET_CMD_STREAM,  streamStart },
+  { "stop",    4, MET_CMD_STOP,    cmdStop },
+  { "proto",   5, MET_CMD_PROTO,   protoSet },
+  { "config",  6, MET_CMD_CONFIG,  configSet },
+  { "metrics", 7, MET_CMD_METRICS, cmdMetrics },
+  { "batch",   5, MET_CMD_BATCH,   cmdBatch },
+  { "trigger", 7, MET_CMD_TRIGGER, trigCmd },
+  { "history", 7, MET_CMD_HISTORY, historyCmd },
+  { "report",  6, MET_CMD_REPORT,  reportCmd },
+  { "exit",    4, MET_CMD_EXIT,    cmdExit }
+};
+
+static const cmd_def_s cmdUnknownDef = { "", 0, MET_CMD_UNKNOWN, cmdUnknown };
+
+/**************** Global Functions Definitions ******************/
+
+void cmdInit(cmd_sess_s *sess, acq_shared_s *shm)
+{
+  memset(sess, 0, sizeof(cmd_sess_s));
+  sess->shm = shm;
+}
+
+// Directory sample log is kept in, "log" command reads history there
+void cmdSetLogDir(const char *dir)
+{
+  logDir = dir;
+}
+
+/* Execute one client command (without line terminator) and append
+ * its reply to "reply". Sample commands take optional channel number
+ * of device, channel 0 by default. Time it takes goes to histogram of
+ * the command. Returns CMD_CONT, CMD_EXIT or CMD_FAIL */
+int cmdExec(cmd_sess_s *sess, char *cmd, cmd_reply_s *reply)
+{
+  long long t0 = metNow();
+  const cmd_def_s *def;
+  char *name, *args;
+  int ret;
+
+  // Split command name from its arguments
+  name = strtok_r(cmd, " \t", &args);
+  def = cmdFind(name != NULL ? name : "");
+
+  ret = def->run(sess, args, reply);
+  metObserve(def->met, metNow() - t0);
+
+  return ret;
+}
+
+/* Monotonic time in ns when next stream sample is due,
+ * -1 if session is not streaming */
+long long cmdStreamDue(cmd_sess_s *sess)
+{
+  return sess->streamPeriodNs ? sess->streamNextNs : -1;
+}
+
+/* Append stream sample to "reply" if it is due, otherwise leave
+ * reply as it is. Returns CMD_CONT or CMD_FAIL like cmdExec() */
+int cmdStreamPush(cmd_sess_s *sess, cmd_reply_s *reply)
+{
+  acq_sample_s sAcq;
+  char num[FMT_FIXED_SIZE];
+  long long now;
+
+  now = acqNowNs();
+  if (sess->streamPeriodNs == 0 || now < sess->streamNextNs)
+    return CMD_CONT;
+
+  // Keep period steady, but do not try to catch up with missed pushes
+  sess->streamNextNs += sess->streamPeriodNs;
+  if (sess->streamNextNs <= now)
+    sess->streamNextNs = now + sess->streamPeriodNs;
+
+  acqSnapshot(&sess->shm->chan[sess->streamChan], &sAcq);
+  if (sampleCheck(sess, &sAcq,
+		  ((sess->streamFields & STREAM_VOLTAGE) ? ACQ_ERR_SHUNT | ACQ_ERR_BUS : 0) |
+		  ((sess->streamFields & STREAM_CURRENT) ? ACQ_ERR_CURR : 0),
+		  reply)) {
+    sess->streamPeriodNs = 0;
+    return CMD_FAIL;
+  }
+
+  // Binary sample frame always carries all registers
+  if (sess->proto == PROTO_BINARY) {
+    reply->len += binSample(reply->buf + reply->len, &sAcq, sess->streamChan);
+    return CMD_CONT;
+  }
+
+  replyf(sess, reply, "{ \"timestamp\":\"%s\"%s", tsText(&sAcq),
+	 chanText(sess, sess->streamChan));
+  if (sess->streamFields & STREAM_VOLTAGE)
+    replyf(sess, reply, ", \"voltage\":%s", voltText(&sAcq, num));
+  if (sess->streamFields & STREAM_CURRENT)
+    replyf(sess, reply, ", \"current\":%s", currText(&sAcq, num));
+  replyf(sess, reply, " };\n");
+
+  return CMD_CONT;
+}
+
+/***************** Local Functions Definitions ******************/
+
+/**********************************   Voltage   ************************************/
+static int cmdVoltage(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  acq_sample_s sAcq;
+  char volt[FMT_FIXED_SIZE];
+  int ch;
+
+  if ((ch = chanArg(sess, strtok_r(NULL, " \t", &args), reply)) == -1)
+    return CMD_CONT;
+
+  // Take latest sample published by acquisition worker
+  acqSnapshot(&sess->shm->chan[ch], &sAcq);
+  if (sampleCheck(sess, &sAcq, ACQ_ERR_SHUNT | ACQ_ERR_BUS, reply))
+    return CMD_FAIL;
+  if (sess->proto == PROTO_BINARY) {
+    reply->len += binSample(reply->buf + reply->len, &sAcq, ch);
+    return CMD_CONT;
+  }
+
+#ifdef JSON
+  replyf(sess, reply, "{ \"timestamp\":\"%s\"%s, \"voltage\":%s };\n",
+	 tsText(&sAcq), chanText(sess, ch), voltText(&sAcq, volt));
+#else // JSON
+  voltage(sess, &sAcq);
+  replyf(sess, reply, "The actual value of shunt voltage: %.2f mV\n"
+	 "The actual value of bus voltage: %.2f\n",
+	 acqShuntMv(&sAcq), sess->realBusVoltVal);
+#endif // JSON
+
+  return CMD_CONT;
+}
+
+/**********************************   Current    **********************************/
+static int cmdCurrent(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  acq_sample_s sAcq;
+  char curr[FMT_FIXED_SIZE];
+  int ch;
+
+  if ((ch = chanArg(sess, strtok_r(NULL, " \t", &args), reply)) == -1)
+    return CMD_CONT;
+
+  // Take latest sample published by acquisition worker
+  acqSnapshot(&sess->shm->chan[ch], &sAcq);
+  if (sampleCheck(sess, &sAcq, ACQ_ERR_CURR, reply))
+    return CMD_FAIL;
+  if (sess->proto == PROTO_BINARY) {
+    reply->len += binSample(reply->buf + reply->len, &sAcq, ch);
+    return CMD_CONT;
+  }
+
+#ifdef JSON
+  replyf(sess, reply, "{ \"timestamp\":\"%s\"%s, \"current\":%s };\n",
+	 tsText(&sAcq), chanText(sess, ch), currText(&sAcq, curr));
+#else // JSON
+  replyf(sess, reply, "The actual value of current: %.2f A\n",
+	 acqCurrent(&sAcq));
+#endif // JSON
+
+  return CMD_CONT;
+}
+
+/*************************************    log    ***********************************/
+static int cmdLog(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  acq_sample_s sAcq;
+  char volt[FMT_FIXED_SIZE], curr[FMT_FIXED_SIZE];
+  char *tok;
+  int ch;
+
+  tok = strtok_r(NULL, " \t", &args);
+  if (tok != NULL && !strcmp(tok, "all"))
+    return logAll(sess, reply);
+  if ((ch = chanArg(sess, tok, reply)) == -1)
+    return CMD_CONT;
+  if ((tok = strtok_r(NULL, " \t", &args)) != NULL)
+    return logHistory(sess, ch, tok, strtok_r(NULL, " \t", &args), reply);
+
+  // Take latest sample published by acquisition worker
+  acqSnapshot(&sess->shm->chan[ch], &sAcq);
+  if (sampleCheck(sess, &sAcq, ACQ_ERR_SHUNT | ACQ_ERR_BUS | ACQ_ERR_CURR,
+		  reply))
+    return CMD_FAIL;
+  if (sess->proto == PROTO_BINARY) {
+    reply->len += binSample(reply->buf + reply->len, &sAcq, ch);
+    return CMD_CONT;
+  }
+
+#ifdef JSON
+  replyf(sess, reply,
+	 "{\n\"log\":{ \"timestamp\":\"%s\"%s, \"voltage\":%s, \"current\":%s }\n}\n",
+	 tsText(&sAcq), chanText(sess, ch), voltText(&sAcq, volt),
+	 currText(&sAcq, curr));
+#else // JSON
+  voltage(sess, &sAcq);
+  replyf(sess, reply, "The actual value of shunt voltage: %.2f mV\n"
+	 "The actual value of bus voltage: %.2f\n",
+	 acqShuntMv(&sAcq), sess->realBusVoltVal);
+#endif // JSON
+
+  return CMD_CONT;
+}
+
+/*************************************  metrics   **********************************/
+static int cmdMetrics(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  char text[CMD_REPLY_SIZE];
+
+  metJson(sess->shm, text, sizeof text);
+  replyf(sess, reply, "%s", text);
+
+  return CMD_CONT;
+}
+
+/*************************************    batch   **********************************/
+/* Connection splits "batch cmd;cmd;..." into pipelined command lines,
+ * so only batch without any command gets here */
+static int cmdBatch(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+#ifdef JSON
+  replyf(sess, reply, "{ \"WARN\":\"Usage: batch <command>[;<command>]...\" }\n");
+#else // JSON
+  replyf(sess, reply, "Usage: batch <command>[;<command>]...\n");
+#endif // JSON
+
+  return CMD_CONT;
+}
+
+/*************************************    stop    **********************************/
+static int cmdStop(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  sess->streamPeriodNs = 0;
+#ifdef JSON
+  replyf(sess, reply, "{ \"INFO\":\"Stream stopped\" }\n");
+#else // JSON
+  replyf(sess, reply, "Stream stopped\n");
+#endif // JSON
+
+  return CMD_CONT;
+}
+
+/*************************************    exit    **********************************/
+static int cmdExit(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  return CMD_EXIT;
+}
+
+/*******************************   Unknown command   *******************************/
+static int cmdUnknown(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+#ifdef JSON
+  replyf(sess, reply, "{ \"WARN\":\"Unrecognized command! Valid commands are: "
+	 VALID_CMDS "\" }\n");
+#else //JSON
+  replyf(sess, reply, "Unrecognized command!\n"
+	 "Valid commands are: " VALID_CMDS "\n");
+#endif //JSON
+
+  return CMD_CONT;
+}
+
+/* Table entry of command name, cmdUnknown's one if there is none.
+ * Length is compared first, most names differ in it already */
+static const cmd_def_s *cmdFind(const char *name)
+{
+  size_t len = strlen(name);
+  int i;
+
+  for (i = 0; i < CMD_DEFS; i++)
+    if (cmdDefs[i].len == len && !memcmp(cmdDefs[i].name, name, len))
+      return &cmdDefs[i];
+
+  return &cmdUnknownDef;
+}
+
+/* Append formatted text to reply. In binary mode every call makes
+ * one text frame, text which does not fit is truncated */
+static void replyf(cmd_sess_s *sess, cmd_reply_s *reply, const char *fmt, ...)
+{
+  va_list ap;
+  size_t hdr, room;
+  int len;
+
+  hdr = (sess->proto == PROTO_BINARY) ? BIN_HDR_SIZE : 0;
+  if (reply->len + hdr >= reply->size)
+    return;
+  room = reply->size - reply->len - hdr;
+
+  va_start(ap, fmt);
+  len = vsnprintf(reply->buf + reply->len + hdr, room, fmt, ap);
+  va_end(ap);
+
+  if (len < 0)
+    return;
+  if ((size_t)len >= room)
+    len = room - 1;
+
+  if (hdr)
+    reply->len += binText(reply->buf + reply->len, len);
+  else
+    reply->len += len;
+}
+
+/* Check read errors of registers "regs" (ACQ_ERR_* bits) in sample.
+ * On error put ERROR reply of first failed register and return -1 */
+static int sampleCheck(cmd_sess_s *sess, acq_sample_s *smp, int regs,
+		       cmd_reply_s *reply)
+{
+  int err = smp->err & regs;
+
+  if (err)
+    replyf(sess, reply, "{ \"ERROR\":\"%s\" }\n", errText(err));
+
+  return err ? -1 : 0;
+}
+
+// Failed read of first register in ACQ_ERR_* bits err
+static const char *errText(int err)
+{
+  if (err & ACQ_ERR_SHUNT)
+    return "i2c_read_data_word(shunt-volt-reg)";
+  if (err & ACQ_ERR_BUS)
+    return "i2c_read_data_word(bus-volt-reg)";
+
+  return "i2c_read_data_word(current-reg)";
+}
+
+/* Channel number given by tok, channel 0 if tok is NULL. Invalid one
+ * gets WARN reply and -1 is returned */
+static int chanArg(cmd_sess_s *sess, const char *tok, cmd_reply_s *reply)
+{
+  char *end;
+  long ch;
+
+  if (tok == NULL)
+    return 0;
+
+  ch = strtol(tok, &end, 10);
+  if (end == tok || *end != '\0' || ch < 0 || ch >= sess->shm->nchan) {
+    replyf(sess, reply, "{ \"WARN\":\"Invalid channel '%.16s', valid are 0..%d\" }\n",
+	   tok, sess->shm->nchan - 1);
+    return -1;
+  }
+
+  return ch;
+}
+
+// JSON channel field, left out when server samples single device
+static const char *chanText(cmd_sess_s *sess, int ch)
+{
+  static __thread char text[24];
+
+  if (sess->shm->nchan == 1)
+    return "";
+
+  snprintf(text, sizeof text, ", \"channel\":%d", ch);
+  return text;
+}
+
+/* ISO-8601 local time of sample with milliseconds, offset as +hh:mm.
+ * Everything but milliseconds changes once a second, so only then it
+ * is formatted, milliseconds are put in the cached text */
+static const char *tsText(const acq_sample_s *smp)
+{
+  static __thread time_t cachedSec = -1;
+  static __thread char text[48];
+  static __thread size_t msOff;         // Where milliseconds go in text
+  long long t0;
+  int64_t wallNs;
+  char *zone;
+  time_t sec;
+  struct tm tm;
+  int ms;
+
+  wallNs = acqWallNs(smp);
+  sec = wallNs / 1000000000LL;
+
+  // Only this slow path is timed, the rest costs less than the clock
+  if (sec != cachedSec) {
+    t0 = metNow();
+    localtime_r(&sec, &tm);
+    msOff = strftime(text, sizeof text, "%Y-%m-%dT%H:%M:%S.", &tm);
+    zone = text + msOff + 3;
+    // strftime() gives +hhmm, ISO-8601 extended format wants colon
+    if (strftime(zone, sizeof text - msOff - 3, "%z", &tm) == 5) {
+      memmove(zone + 4, zone + 3, 3);
+      zone[3] = ':';
+    }
+    cachedSec = sec;
+    metObserve(MET_TS_FORMAT, metNow() - t0);
+  }
+
+  // Only milliseconds are put in, there are always three digits
+  ms = wallNs % 1000000000LL / 1000000;
+  text[msOff] = '0' + ms / 100;
+  text[msOff + 1] = '0' + ms / 10 % 10;
+  text[msOff + 2] = '0' + ms % 10;
+
+  return text;
+}
+
+#ifndef JSON
+/* Load voltage in V of plain text replies, bus voltage plus shunt
+ * voltage. Bus register always holds the latest conversion, CNVR there
+ * only tells whether acquisition worker saw it first time (see
+ * acqFresh()) */
+static double voltage(cmd_sess_s *sess, acq_sample_s *smp)
+{
+  sess->realBusVoltVal = busVoltConv(smp->busRegVal);
+
+  return acqVoltage(smp);
+}
+#endif // JSON
+
+/* Load voltage of reply, "%.2f" V done in fixed point. Buf has
+ * FMT_FIXED_SIZE bytes */
+static const char *voltText(const acq_sample_s *smp, char *buf)
+{
+  return fmtFixed(buf, acqVoltageUv(smp), 6, 2);
+}
+
+// Current of reply like voltText(), in A
+static const char *currText(const acq_sample_s *smp, char *buf)
+{
+  return fmtFixed(buf, acqCurrentUa(smp), 6, 2);
+}
+
+/* "log all", latest sample of every channel in one reply. Channel
+ * which failed to read gets ERROR entry, the others are still valid,
+ * so connection is kept */
+static int logAll(cmd_sess_s *sess, cmd_reply_s *reply)
+{
+  acq_sample_s sAcq;
+  char volt[FMT_FIXED_SIZE], curr[FMT_FIXED_SIZE];
+  int ch, err;
+
+#ifdef JSON
+  if (sess->proto != PROTO_BINARY)
+    replyf(sess, reply, "{\n\"log\":[\n");
+#endif // JSON
+
+  for (ch = 0; ch < sess->shm->nchan; ch++) {
+    acqSnapshot(&sess->shm->chan[ch], &sAcq);
+    err = sAcq.err & (ACQ_ERR_SHUNT | ACQ_ERR_BUS | ACQ_ERR_CURR);
+
+    if (sess->proto == PROTO_BINARY) {
+      if (err)
+	replyf(sess, reply, "{ \"channel\":%d, \"ERROR\":\"%s\" }\n",
+	       ch, errText(err));
+      else
+	reply->len += binSample(reply->buf + reply->len, &sAcq, ch);
+      continue;
+    }
+
+#ifdef JSON
+    if (err)
+      replyf(sess, reply, "{ \"channel\":%d, \"ERROR\":\"%s\" }", ch, errText(err));
+    else
+      replyf(sess, reply, "{ \"timestamp\":\"%s\", \"channel\":%d, \"voltage\":%s, "
+	     "\"current\":%s }", tsText(&sAcq), ch, voltText(&sAcq, volt),
+	     currText(&sAcq, curr));
+    replyf(sess, reply, (ch + 1 < sess->shm->nchan) ? ",\n" : "\n");
+#else // JSON
+    if (err)
+      replyf(sess, reply, "Channel %d: %s failed\n", ch, errText(err));
+    else
+      replyf(sess, reply, "Channel %d: voltage %.2f V, current %.2f A\n",
+	     ch, voltage(sess, &sAcq), acqCurrent(&sAcq));
+#endif // JSON
+  }
+
+#ifdef JSON
+  if (sess->proto != PROTO_BINARY)
+    replyf(sess, reply, "]\n}\n");
+#endif // JSON
+
+  return CMD_CONT;
+}
+
+/* "log <channel> <from> [count]", up to count samples of the sample
+ * log taken at from (seconds since Epoch) or later. JSON reply tells
+ * in "next" where the following page starts */
+static int logHistory(cmd_sess_s *sess, int ch, const char *fromArg,
+		      const char *countArg, cmd_reply_s *reply)
+{
+  acq_sample_s sAcq;
+  ring_sample_s rs;
+  log_reader_s rd;
+  double from;
+  long count = LOG_PAGE_DEF;
+  char *end;
+  int n;
+
+  if (logDir == NULL) {
+    replyf(sess, reply, "{ \"WARN\":\"Sample log is off, server runs without -l\" }\n");
+    return CMD_CONT;
+  }
+
+  from = strtod(fromArg, &end);
+  if (*end == '\0' && countArg != NULL)
+    count = strtol(countArg, &end, 10);
+  // Far future would overflow ns since Epoch
+  if (*end != '\0' || !(from >= 0.0 && from < 9e9) || count < 1 || count > LOG_PAGE_MAX) {
+    replyf(sess, reply, "{ \"WARN\":\"Usage: log <channel> <from-epoch-s> [count 1..%d]\" }\n",
+	   LOG_PAGE_MAX);
+    return CMD_CONT;
+  }
+
+  // Log keeps us, rounding keeps "next" exact in spite of double
+  if (logOpen(&rd, logDir, ch, (int64_t)(from * 1e6 + 0.5) * 1000) == -1) {
+    replyf(sess, reply, "{ \"ERROR\":\"logOpen(%s)\" }\n", strerror(errno));
+    return CMD_CONT;
+  }
+
+#ifdef JSON
+  if (sess->proto != PROTO_BINARY)
+    replyf(sess, reply, "{\n\"log\":[");
+#endif // JSON
+
+  memset(&sAcq, 0, sizeof sAcq);
+  for (n = 0; n < count && logNext(&rd, &rs) == 1; n++) {
+    ringToAcq(&rs, &sAcq);
+    historySample(sess, &sAcq, ch, n, reply);
+  }
+
+#ifdef JSON
+  if (sess->proto != PROTO_BINARY) {
+    if (logNext(&rd, &rs) == 1)
+      replyf(sess, reply, "\n],\n\"next\":%lld.%09lld\n}\n",
+	     (long long)(rs.tsNs / 1000000000LL), (long long)(rs.tsNs % 1000000000LL));
+    else
+      replyf(sess, reply, "\n]\n}\n");
+  }
+#endif // JSON
+
+  logClose(&rd);
+  return CMD_CONT;
+}
+
+// Sample of ring, log or capture as published one, wall time already
+static void ringToAcq(const ring_sample_s *rs, acq_sample_s *smp)
+{
+  smp->seq = rs->seq;
+  smp->err = rs->err;
+  smp->tsNs = rs->tsNs;
+  smp->rtOffsetNs = 0;
+  smp->shuntRegVal = rs->shuntRegVal;
+  smp->busRegVal = rs->busRegVal;
+  smp->currRegVal = rs->currRegVal;
+  smp->powerRegVal = rs->powerRegVal;
+  smp->conf.currLsbA = rs->currLsbA;
+  smp->conf.currLsbPa = confLsbPa(rs->currLsbA);
+}
+
+/* Reply entry of n-th sample in JSON array of history, or its frame
+ * in binary protocol */
+static void historySample(cmd_sess_s *sess, acq_sample_s *smp, int ch, int n,
+			  cmd_reply_s *reply)
+{
+  char volt[FMT_FIXED_SIZE], curr[FMT_FIXED_SIZE];
+  int err = smp->err & (ACQ_ERR_SHUNT | ACQ_ERR_BUS | ACQ_ERR_CURR);
+
+  // Failed sample goes as text frame, its registers are stale
+  if (sess->proto == PROTO_BINARY) {
+    if (err)
+      replyf(sess, reply, "{ \"timestamp\":\"%s\"%s, \"ERROR\":\"%s\" }\n",
+	     tsText(smp), chanText(sess, ch), errText(err));
+    else
+      reply->len += binSample(reply->buf + reply->len, smp, ch);
+    return;
+  }
+
+#ifdef JSON
+  replyf(sess, reply, "%s\n", n ? "," : "");
+  if (err)
+    replyf(sess, reply, "{ \"timestamp\":\"%s\"%s, \"ERROR\":\"%s\" }",
+	   tsText(smp), chanText(sess, ch), errText(err));
+  else
+    replyf(sess, reply, "{ \"timestamp\":\"%s\"%s, \"voltage\":%s, \"current\":%s }",
+	   tsText(smp), chanText(sess, ch), voltText(smp, volt),
+	   currText(smp, curr));
+#else // JSON
+  if (err)
+    replyf(sess, reply, "%s %s failed\n", tsText(smp), errText(err));
+  else
+    replyf(sess, reply, "%s voltage %.2f V, current %.2f A\n",
+	   tsText(smp), voltage(sess, smp), acqCurrent(smp));
+#endif // JSON
+}
+
+/* "stats <window> [channel]", minimum, maximum, mean, RMS and standard
+ * deviation of voltage and current over last window seconds, kept
+ * by acquisition worker as it goes, so reply takes the same time
+ * whatever sample rate is. Window is rounded up to whole buckets and
+ * limited to the time buckets are kept */
+static int statsReply(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  stats_agg_s volt, curr;
+  char voltText[160], currText[160];
+  char *tok, *end, *save;
+  double window, maxWindow = STATS_BUCKETS * (STATS_BUCKET_NS / 1e9);
+  uint32_t n;
+  int ch;
+
+  tok = strtok_r(args, " \t", &save);
+  window = (tok != NULL) ? strtod(tok, &end) : 0.0;
+  if (tok == NULL || *end != '\0' || !(window > 0.0)) {
+    replyf(sess, reply, "{ \"WARN\":\"Usage: stats <window-s> [channel]\" }\n");
+    return CMD_CONT;
+  }
+  if (window > maxWindow)
+    window = maxWindow;
+
+  if ((ch = chanArg(sess, strtok_r(NULL, " \t", &save), reply)) == -1)
+    return CMD_CONT;
+
+  n = statsQuery(&sess->shm->stats[ch], acqNowNs(), (int64_t)(window * 1e9),
+		 &volt, &curr);
+
+  aggText("voltage", &volt, voltText, sizeof voltText);
+  aggText("current", &curr, currText, sizeof currText);
+  replyf(sess, reply, "{ \"stats\":{ \"window\":%g, \"samples\":%u%s, %s, %s } }\n",
+	 window, n, chanText(sess, ch), voltText, currText);
+
+  return CMD_CONT;
+}
+
+// JSON object of aggregate a, all zero when window holds no sample
+static void aggText(const char *name, const stats_agg_s *a, char *buf,
+		    size_t size)
+{
+  snprintf(buf, size, "\"%s\":{ \"min\":%.4f, \"max\":%.4f, \"mean\":%.4f, "
+	   "\"rms\":%.4f, \"std\":%.4f }", name, a->n ? a->min : 0.0,
+	   a->n ? a->max : 0.0, a->mean, statsRms(a), statsStd(a));
+}
+
+/* "history <from> <to> <resolution> [channel]", minimum, maximum and
+ * mean of voltage, current and power in buckets of resolution seconds
+ * from..to (seconds since Epoch). Acquisition worker keeps 1 s, 1 min
+ * and 1 h buckets, rows are merged from the coarsest of them which
+ * resolution is a multiple of. Resolution is rounded up to whole
+ * buckets of the finest level which still keeps from, reply tells
+ * the one used, and in "next" where the following page starts */
+static int historyCmd(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  hist_row_s rows[HISTORY_PAGE], *r;
+  double from = -1.0, to = -1.0;
+  long res = 0;
+  int64_t nextS;
+  char *tok, *end = "-", *save;
+  int i, n, ch;
+
+  if ((tok = strtok_r(args, " \t", &save)) != NULL)
+    from = strtod(tok, &end);
+  if (tok != NULL && *end == '\0' && (tok = strtok_r(NULL, " \t", &save)) != NULL)
+    to = strtod(tok, &end);
+  if (tok != NULL && *end == '\0' && (tok = strtok_r(NULL, " \t", &save)) != NULL)
+    res = strtol(tok, &end, 10);
+
+  // Missing argument leaves end non-empty, far future overflows ns
+  if (tok == NULL || *end != '\0' || !(from >= 0.0 && from < to && to < 9e9) ||
+      res < 1 || res > HIST_HOUR_BUCKETS * HIST_HOUR_S) {
+    replyf(sess, reply, "{ \"WARN\":\"Usage: history <from-epoch-s> <to-epoch-s> "
+	   "<resolution-s> [channel]\" }\n");
+    return CMD_CONT;
+  }
+
+  if ((ch = chanArg(sess, strtok_r(NULL, " \t", &save), reply)) == -1)
+    return CMD_CONT;
+
+  res = histResolution((int64_t)from, res);
+  n = histQuery(&sess->shm->hist[ch], (int64_t)from, (int64_t)ceil(to), res,
+		rows, HISTORY_PAGE, &nextS);
+
+  replyf(sess, reply, "{\n\"history\":{ \"resolution\":%ld, \"bucket\":%d%s, "
+	 "\"columns\":[\"start\", \"samples\", \"voltage_min\", \"voltage_max\", "
+	 "\"voltage_mean\", \"current_min\", \"current_max\", \"current_mean\", "
+	 "\"power_min\", \"power_max\", \"power_mean\"] },\n\"rows\":[",
+	 res, histLevelS(res), chanText(sess, ch));
+
+  for (i = 0; i < n; i++) {
+    r = &rows[i];
+    replyf(sess, reply, "%s\n[%lld,%u,%.4f,%.4f,%.4f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f]",
+	   i ? "," : "", (long long)r->startS, r->volt.n,
+	   r->volt.min, r->volt.max, r->volt.mean,
+	   r->curr.min, r->curr.max, r->curr.mean,
+	   r->power.min, r->power.max, r->power.mean);
+  }
+
+  if (nextS != -1)
+    replyf(sess, reply, "\n],\n\"next\":%lld\n}\n", (long long)nextS);
+  else
+    replyf(sess, reply, "\n]\n}\n");
+
+  return CMD_CONT;
+}
+
+/* "report <from> <to> [channel]", minimum, maximum and mean of load
+ * voltage, shunt voltage and current over sample log from..to (seconds
+ * since Epoch), at full resolution. Log is read in blocks of registers
+ * converted by convBlock(). One reply covers at most REPORT_PAGE
+ * samples, not to hold up other clients of the same process, "next"
+ * tells where the following one starts. Failed reads are counted and
+ * left out, as are overflows */
+static int reportCmd(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  int64_t tsNs[REPORT_BLOCK];
+  int32_t err[REPORT_BLOCK];
+  int16_t shunt[REPORT_BLOCK], bus[REPORT_BLOCK];
+  int16_t curr[REPORT_BLOCK], power[REPORT_BLOCK];
+  float voltV[REPORT_BLOCK], shuntMv[REPORT_BLOCK], currA[REPORT_BLOCK];
+  uint8_t flags[REPORT_BLOCK];
+  log_block_s blk = { tsNs, err, shunt, bus, curr, power, 0.0f };
+  conv_out_s out = { voltV, shuntMv, currA, flags };
+  double min[3] = { HUGE_VAL, HUGE_VAL, HUGE_VAL };
+  double max[3] = { -HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+  double sum[3] = { 0.0, 0.0, 0.0 };
+  double from = -1.0, to = -1.0, v[3];
+  long long good = 0, failed = 0, ovf = 0;
+  char text[3][128], nextText[48], *tok, *end = "-", *save;
+  int64_t toNs;
+  log_reader_s rd;
+  ring_sample_s rs;
+  long left = REPORT_PAGE;
+  int i, j, k, n, ch;
+
+  if (logDir == NULL) {
+    replyf(sess, reply, "{ \"WARN\":\"Sample log is off, server runs without -l\" }\n");
+    return CMD_CONT;
+  }
+
+  if ((tok = strtok_r(args, " \t", &save)) != NULL)
+    from = strtod(tok, &end);
+  if (tok != NULL && *end == '\0' && (tok = strtok_r(NULL, " \t", &save)) != NULL)
+    to = strtod(tok, &end);
+
+  // Missing argument leaves end non-empty, far future overflows ns
+  if (tok == NULL || *end != '\0' || !(from >= 0.0 && from < to && to < 9e9)) {
+    replyf(sess, reply, "{ \"WARN\":\"Usage: report <from-epoch-s> <to-epoch-s> [channel]\" }\n");
+    return CMD_CONT;
+  }
+
+  if ((ch = chanArg(sess, strtok_r(NULL, " \t", &save), reply)) == -1)
+    return CMD_CONT;
+
+  // Log keeps us, see logHistory()
+  if (logOpen(&rd, logDir, ch, (int64_t)(from * 1e6 + 0.5) * 1000) == -1) {
+    replyf(sess, reply, "{ \"ERROR\":\"logOpen(%s)\" }\n", strerror(errno));
+    return CMD_CONT;
+  }
+  toNs = (int64_t)(to * 1e6 + 0.5) * 1000;
+
+  while (left > 0 &&
+	 (n = logBlock(&rd, &blk, left < REPORT_BLOCK ? left : REPORT_BLOCK)) > 0) {
+    left -= n;
+
+    // Log is in time order, block may only end past "to"
+    for (i = 0; i < n && tsNs[i] < toNs; i++)
+      ;
+    convBlock(shunt, bus, curr, i, blk.currLsbA, &out);
+
+    for (j = 0; j < i; j++) {
+      if (err[j] & (ACQ_ERR_SHUNT | ACQ_ERR_BUS | ACQ_ERR_CURR)) {
+	failed++;
+	continue;
+      }
+      if (flags[j] & CONV_F_OVF) {
+	ovf++;
+	continue;
+      }
+
+      v[0] = voltV[j];
+      v[1] = shuntMv[j];
+      v[2] = currA[j];
+      for (k = 0; k < 3; k++) {
+	if (v[k] < min[k])
+	  min[k] = v[k];
+	if (v[k] > max[k])
+	  max[k] = v[k];
+	sum[k] += v[k];
+      }
+      good++;
+    }
+
+    if (i < n)
+      break;
+  }
+
+  // Page is full and log goes on before "to"
+  nextText[0] = '\0';
+  if (left == 0 && logNext(&rd, &rs) == 1 && rs.tsNs < toNs)
+    snprintf(nextText, sizeof nextText, ", \"next\":%lld.%09lld",
+	     (long long)(rs.tsNs / 1000000000LL), (long long)(rs.tsNs % 1000000000LL));
+  logClose(&rd);
+
+  rangeText("voltage", min[0], max[0], sum[0], good, text[0], sizeof text[0]);
+  rangeText("shunt_mV", min[1], max[1], sum[1], good, text[1], sizeof text[1]);
+  rangeText("current", min[2], max[2], sum[2], good, text[2], sizeof text[2]);
+  replyf(sess, reply, "{ \"report\":{ \"samples\":%lld, \"failed\":%lld, "
+	 "\"overflows\":%lld%s, \"kernel\":\"%s\", %s, %s, %s%s } }\n",
+	 good, failed, ovf, chanText(sess, ch), convKernel(),
+	 text[0], text[1], text[2], nextText);
+
+  return CMD_CONT;
+}
+
+// JSON object of minimum, maximum and mean, all zero without samples
+static void rangeText(const char *name, double min, double max, double sum,
+		      long long n, char *buf, size_t size)
+{
+  snprintf(buf, size, "\"%s\":{ \"min\":%.4f, \"max\":%.4f, \"mean\":%.4f }",
+	   name, n ? min : 0.0, n ? max : 0.0, n ? sum / n : 0.0);
+}
+
+/* "energy start <name> [channel]" starts accumulator of energy and
+ * charge (started one is started over), "energy reset <name>" zeroes
+ * it, "energy stop <name>" frees it and "energy read [name]" reports
+ * one accumulator or all of them. Integration runs in acquisition
+ * worker over every conversion, reply only takes the difference */
+static int energyCmd(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  energy_acc_s acc[ENERGY_MAX];
+  acq_sample_s sAcq;
+  char *op, *accName, *save;
+  char text[256], list[CMD_REPLY_SIZE];
+  size_t len;
+  int i, n, ch = 0;
+
+  op = strtok_r(args, " \t", &save);
+  accName = strtok_r(NULL, " \t", &save);
+  if (op == NULL ||
+      (strcmp(op, "read") && accName == NULL) ||
+      (accName != NULL && !energyNameValid(accName))) {
+    replyf(sess, reply, "{ \"WARN\":\"Usage: energy start <name> [channel] | read [name] | "
+	   "reset <name> | stop <name>, name is up to %d of [A-Za-z0-9_.-]\" }\n",
+	   ENERGY_NAME_SIZE - 1);
+    return CMD_CONT;
+  }
+
+  if (!strcmp(op, "start")) {
+    if ((ch = chanArg(sess, strtok_r(NULL, " \t", &save), reply)) == -1)
+      return CMD_CONT;
+
+    acqSnapshot(&sess->shm->chan[ch], &sAcq);
+    memset(&acc[0], 0, sizeof(energy_acc_s));
+    strcpy(acc[0].name, accName);
+    acc[0].ch = ch;
+    acc[0].startNs = sAcq.tsNs;
+    acc[0].energyJ = sAcq.energyJ;
+    acc[0].chargeC = sAcq.chargeC;
+    if (energyStart(&sess->shm->energy, &acc[0]) == -1) {
+      replyf(sess, reply, "{ \"WARN\":\"All %d energy accumulators are taken, stop one first\" }\n",
+	     ENERGY_MAX);
+      return CMD_CONT;
+    }
+    replyf(sess, reply, "{ \"INFO\":\"energy %s started\"%s }\n", accName,
+	   chanText(sess, ch));
+  }
+  else if (!strcmp(op, "reset")) {
+    if (energyGet(&sess->shm->energy, accName, &acc[0]) == 0) {
+      acqSnapshot(&sess->shm->chan[acc[0].ch], &sAcq);
+      n = energyReset(&sess->shm->energy, accName, sAcq.tsNs, sAcq.energyJ,
+		      sAcq.chargeC, acc[0].ch);
+    }
+    else
+      n = -1;
+    if (n == -1)
+      replyf(sess, reply, "{ \"WARN\":\"No energy accumulator '%s'\" }\n", accName);
+    else
+      replyf(sess, reply, "{ \"INFO\":\"energy %s reset\" }\n", accName);
+  }
+  else if (!strcmp(op, "stop")) {
+    if (energyStop(&sess->shm->energy, accName) == -1)
+      replyf(sess, reply, "{ \"WARN\":\"No energy accumulator '%s'\" }\n", accName);
+    else
+      replyf(sess, reply, "{ \"INFO\":\"energy %s stopped\" }\n", accName);
+  }
+  else if (!strcmp(op, "read") && accName != NULL) {
+    if (energyGet(&sess->shm->energy, accName, &acc[0]) == -1) {
+      replyf(sess, reply, "{ \"WARN\":\"No energy accumulator '%s'\" }\n", accName);
+      return CMD_CONT;
+    }
+    energyText(sess, &acc[0], text, sizeof text);
+    replyf(sess, reply, "{ \"energy\":%s }\n", text);
+  }
+  else if (!strcmp(op, "read")) {
+    // One replyf(), so binary mode gets it in one frame
+    n = energyList(&sess->shm->energy, acc);
+    for (i = 0, len = 0, list[0] = '\0'; i < n && len < sizeof list; i++) {
+      energyText(sess, &acc[i], text, sizeof text);
+      len += snprintf(list + len, sizeof list - len, "%s %s", i ? "," : "", text);
+    }
+    replyf(sess, reply, "{ \"energy\":[%s ] }\n", list);
+  }
+  else {
+    replyf(sess, reply, "{ \"WARN\":\"Unknown energy operation '%.16s', valid are "
+	   "'start', 'read', 'reset', 'stop'\" }\n", op);
+  }
+
+  return CMD_CONT;
+}
+
+/* JSON object of accumulator acc up to the latest sample of its
+ * channel, average power included */
+static void energyText(cmd_sess_s *sess, const energy_acc_s *acc, char *buf,
+		       size_t size)
+{
+  acq_sample_s sAcq;
+  double secs, joule, coulomb;
+
+  acqSnapshot(&sess->shm->chan[acc->ch], &sAcq);
+  secs = (sAcq.tsNs - acc->startNs) / 1e9;
+  joule = sAcq.energyJ - acc->energyJ;
+  coulomb = sAcq.chargeC - acc->chargeC;
+
+  snprintf(buf, size, "{ \"name\":\"%s\"%s, \"duration_s\":%.3f, "
+	   "\"energy_J\":%.6g, \"energy_Wh\":%.6g, \"charge_C\":%.6g, "
+	   "\"charge_mAh\":%.6g, \"power_W\":%.6g }", acc->name,
+	   chanText(sess, acc->ch), secs, joule, joule / 3600, coulomb,
+	   coulomb / 3.6, (secs > 0) ? joule / secs : 0.0);
+}
+
+/* "stream <rate> [voltage] [current] [channel]", rate in Hz is capped
+ * at ADC conversion rate of the channel, since faster pushes would
+ * only repeat samples. Channel with ADC off has nothing to stream */
+static int streamStart(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  char *field, *end, *save;
+  double rate, maxRate;
+  int fields = 0, ch = 0;
+
+  field = strtok_r(args, " \t,", &save);
+  rate = (field != NULL) ? strtod(field, &end) : 0.0;
+  if (field == NULL || *end != '\0' || !(rate >= STREAM_MIN_HZ)) {
+    replyf(sess, reply, "{ \"WARN\":\"Usage: stream <rate-Hz> [voltage] [current] "
+	   "[channel], rate at least %g Hz\" }\n", STREAM_MIN_HZ);
+    return CMD_CONT;
+  }
+
+  while ((field = strtok_r(NULL, " \t,", &save)) != NULL) {
+    if (!strcmp(field, "voltage"))
+      fields |= STREAM_VOLTAGE;
+    else if (!strcmp(field, "current"))
+      fields |= STREAM_CURRENT;
+    else if (isdigit((unsigned char)field[0])) {
+      if ((ch = chanArg(sess, field, reply)) == -1)
+	return CMD_CONT;
+    }
+    else {
+      replyf(sess, reply,
+	       "{ \"WARN\":\"Unknown stream field '%.64s', valid are 'voltage', 'current'\" }\n",
+	       field);
+      return CMD_CONT;
+    }
+  }
+  if (fields == 0)
+    fields = STREAM_VOLTAGE | STREAM_CURRENT;
+
+  if (sess->shm->chan[ch].periodUs == 0) {
+    replyf(sess, reply, "{ \"WARN\":\"ADC of channel %d is off, set its mode by 'config' first\" }\n",
+	   ch);
+    return CMD_CONT;
+  }
+
+  maxRate = 1e6 / sess->shm->chan[ch].periodUs;
+  if (rate > maxRate)
+    rate = maxRate;
+
+  sess->streamChan = ch;
+  sess->streamFields = fields;
+  sess->streamPeriodNs = (long long)(1e9 / rate);
+  sess->streamNextNs = acqNowNs() + sess->streamPeriodNs;
+
+  replyf(sess, reply, "{ \"INFO\":\"Streaming at %g Hz, send 'stop' to end\" }\n",
+	   rate);
+
+  return CMD_CONT;
+}
+
+/* "proto json|binary" switches reply format of the connection. The
+ * confirmation already goes in the new format, the binary one tells
+ * scale of raw register values carried by sample frames */
+static int protoSet(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  char *mode, *save;
+  char currLsb[CMD_REPLY_SIZE / 4], powerLsb[CMD_REPLY_SIZE / 4];
+
+  mode = strtok_r(args, " \t", &save);
+
+  if (mode != NULL && !strcmp(mode, "json")) {
+    sess->proto = PROTO_JSON;
+    replyf(sess, reply, "{ \"INFO\":\"proto json\" }\n");
+  }
+  else if (mode != NULL && !strcmp(mode, "binary")) {
+    lsbList(sess, 1, currLsb, sizeof currLsb);
+    lsbList(sess, 20, powerLsb, sizeof powerLsb);
+    sess->proto = PROTO_BINARY;
+    replyf(sess, reply, "{ \"INFO\":\"proto binary\", \"frame\":%d, "
+	   "\"shuntLsb_mV\":%g, \"busLsb_V\":%g, \"busShift\":3, "
+	   "\"currLsb_A\":%s, \"powerLsb_W\":%s }\n",
+	   BIN_SAMPLE_SIZE, shuntVoltConv(1), busVoltConv(1 << 3),
+	   currLsb, powerLsb);
+  }
+  else {
+    replyf(sess, reply, "{ \"WARN\":\"Usage: proto json|binary\" }\n");
+  }
+
+  return CMD_CONT;
+}
+
+/* "config [channel] [key value]..." requests new settings (see
+ * confParse()) of INA219 from its acquisition worker, which applies
+ * them at its next wake-up. Replies with resulting settings,
+ * conversion period and scale of current, plain "config" only
+ * reports them */
+static int configSet(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  ina_conf_s *req, conf;
+  char err[160], sadc[8], badc[8];
+  int change, ch = 0, ret = 0;
+
+  // Keys are never numeric, leading number is channel
+  args += strspn(args, " \t");
+  if (isdigit((unsigned char)args[0]) &&
+      (ch = chanArg(sess, strtok_r(args, " \t", &args), reply)) == -1)
+    return CMD_CONT;
+
+  change = args[strspn(args, " \t")] != '\0';
+
+  req = acqConfBegin(&sess->shm->chan[ch]);
+  conf = *req;
+  if (change && (ret = confParse(&conf, args, err, sizeof err)) == 0)
+    *req = conf;
+  acqConfEnd(&sess->shm->chan[ch], change && ret == 0);
+
+  if (ret == -1) {
+    replyf(sess, reply, "{ \"WARN\":\"%s\" }\n", err);
+    return CMD_CONT;
+  }
+
+  replyf(sess, reply, "{ \"config\":{ \"mode\":\"%s\", \"sadc\":\"%s\", "
+	 "\"badc\":\"%s\", \"pga\":%d, \"brng\":%d, \"rshunt\":%g, "
+	 "\"imax\":%g, \"reg\":\"0x%04hx\", \"calib\":\"0x%04hx\", "
+	 "\"currLsb_A\":%g, \"period_us\":%ld }%s }\n",
+	 confModeName(&conf), confAdcName(&conf, CONF_SADC_SHIFT, sadc, sizeof sadc),
+	 confAdcName(&conf, CONF_BADC_SHIFT, badc, sizeof badc),
+	 confPgaGain(&conf), confBusRange(&conf), conf.rshuntOhm, conf.imaxA,
+	 conf.confRegVal, conf.calibRegVal, conf.currLsbA,
+	 acqConvPeriodUs(conf.confRegVal), chanText(sess, ch));
+
+  return CMD_CONT;
+}
+
+/* "trigger [channel] current|voltage above|below|rise|fall <level>
+ * [pre [post]]" arms capture of pre conversions before the one which
+ * meets condition and post conversions from it on. Level is in A or
+ * V, for rise and fall it is change since previous conversion. Every
+ * conversion is captured, at the rate "config" set. "trigger [channel]"
+ * reports state of capture, "trigger [channel] read [from [count]]"
+ * pages through finished one like "log" does and "trigger [channel]
+ * cancel" disarms */
+static int trigCmd(cmd_sess_s *sess, char *args, cmd_reply_s *reply)
+{
+  trig_cond_s cond;
+  char *tok, *end = "-";
+  double level = 0.0;
+  long pre = TRIG_DEF_PRE, post = TRIG_DEF_POST;
+  int ch = 0;
+
+  // Subcommands are never numeric, leading number is channel
+  args += strspn(args, " \t");
+  if (isdigit((unsigned char)args[0]) &&
+      (ch = chanArg(sess, strtok_r(args, " \t", &args), reply)) == -1)
+    return CMD_CONT;
+
+  tok = strtok_r(args, " \t", &args);
+  if (tok == NULL)
+    return trigStatus(sess, ch, reply);
+  if (!strcmp(tok, "read"))
+    return trigCapture(sess, ch, args, reply);
+
+  memset(&cond, 0, sizeof cond);
+  if (!strcmp(tok, "cancel")) {
+    trigArm(&sess->shm->trig[ch], &cond);
+    replyf(sess, reply, "{ \"INFO\":\"trigger cancelled\"%s }\n", chanText(sess, ch));
+    return CMD_CONT;
+  }
+
+  cond.quantity = nameIndex(tok, trigQuantities, 2);
+  cond.edge = nameIndex(strtok_r(NULL, " \t", &args), trigEdges, 4);
+  if ((tok = strtok_r(NULL, " \t", &args)) != NULL)
+    level = strtod(tok, &end);
+  if (tok != NULL && *end == '\0' && (tok = strtok_r(NULL, " \t", &args)) != NULL)
+    pre = strtol(tok, &end, 10);
+  if (tok != NULL && *end == '\0' && (tok = strtok_r(NULL, " \t", &args)) != NULL)
+    post = strtol(tok, &end, 10);
+
+  // End stays non-empty without level, change by nothing would fire always
+  if (cond.quantity == -1 || cond.edge == -1 || *end != '\0' ||
+      !(level > -1e6 && level < 1e6) ||
+      (cond.edge >= TRIG_RISE && !(level > 0.0)) ||
+      pre < 0 || post < 1 || pre + post > TRIG_MAX_SAMPLES) {
+    replyf(sess, reply, "{ \"WARN\":\"" TRIG_USAGE "\" }\n", TRIG_MAX_SAMPLES);
+    return CMD_CONT;
+  }
+
+  cond.level = llround(level * 1e6);
+  cond.pre = pre;
+  cond.post = post;
+
+  replyf(sess, reply, "{ \"trigger\":{ \"id\":%u, \"state\":\"armed\"%s, "
+	 "\"pre\":%ld, \"post\":%ld, \"period_us\":%ld } }\n",
+	 trigArm(&sess->shm->trig[ch], &cond), chanText(sess, ch), pre, post,
+	 sess->shm->chan[ch].periodUs);
+
+  return CMD_CONT;
+}
+
+/* State of trigger of channel ch. Request the worker did not take
+ * yet is "pending", time and value of trigger conversion are there
+ * once it fired */
+static int trigStatus(cmd_sess_s *sess, int ch, cmd_reply_s *reply)
+{
+  trig_chan_s *tc = &sess->shm->trig[ch];
+  trig_info_s info;
+  acq_sample_s sAcq;
+  char level[FMT_FIXED_SIZE], val[FMT_FIXED_SIZE];
+  const char *state;
+
+  trigRead(tc, &info, 0, NULL, 0);
+  state = trigStateName(info.state);
+  if (__atomic_load_n(&tc->reqSeq, __ATOMIC_ACQUIRE) != info.id)
+    state = "pending";
+
+  if (info.state == TRIG_IDLE) {
+    replyf(sess, reply, "{ \"trigger\":{ \"id\":%u, \"state\":\"%s\"%s } }\n",
+	   info.id, state, chanText(sess, ch));
+    return CMD_CONT;
+  }
+
+  replyf(sess, reply, "{ \"trigger\":{ \"id\":%u, \"state\":\"%s\"%s, "
+	 "\"quantity\":\"%s\", \"edge\":\"%s\", \"level\":%s, \"pre\":%u, \"post\":%u",
+	 info.id, state, chanText(sess, ch), trigQuantities[info.cond.quantity & 1],
+	 trigEdges[info.cond.edge & 3], fmtFixed(level, info.cond.level, 6, 6),
+	 info.cond.pre, info.cond.post);
+
+  if (info.state >= TRIG_FIRED) {
+    memset(&sAcq, 0, sizeof sAcq);
+    sAcq.tsNs = info.trigNs;
+    replyf(sess, reply, ", \"timestamp\":\"%s\", \"value\":%s",
+	   tsText(&sAcq), fmtFixed(val, info.trigVal, 6, 6));
+  }
+  replyf(sess, reply, " } }\n");
+
+  return CMD_CONT;
+}
+
+/* "trigger [channel] read [from [count]]", count samples of finished
+ * capture from from-th one on, trigger conversion is the pre-th.
+ * "next" is there while capture has more of them, "id" tells client
+ * the capture did not change between pages */
+static int trigCapture(cmd_sess_s *sess, int ch, char *args, cmd_reply_s *reply)
+{
+  ring_sample_s rs[LOG_PAGE_MAX];
+  trig_info_s info;
+  acq_sample_s sAcq;
+  char *tok, *end = "";
+  long from = 0, count = LOG_PAGE_DEF;
+  int n, i;
+
+  if ((tok = strtok_r(args, " \t", &args)) != NULL)
+    from = strtol(tok, &end, 10);
+  if (*end == '\0' && (tok = strtok_r(NULL, " \t", &args)) != NULL)
+    count = strtol(tok, &end, 10);
+  if (*end != '\0' || from < 0 || from >= TRIG_MAX_SAMPLES ||
+      count < 1 || count > LOG_PAGE_MAX) {
+    replyf(sess, reply, "{ \"WARN\":\"Usage: trigger [channel] read [from [count 1..%d]]\" }\n",
+	   LOG_PAGE_MAX);
+    return CMD_CONT;
+  }
+
+  n = trigRead(&sess->shm->trig[ch], &info, from, rs, count);
+  if (info.state != TRIG_DONE) {
+    replyf(sess, reply, "{ \"WARN\":\"No capture, trigger is %s\" }\n",
+	   trigStateName(info.state));
+    return CMD_CONT;
+  }
+
+#ifdef JSON
+  if (sess->proto != PROTO_BINARY)
+    replyf(sess, reply, "{\n\"capture\":[");
+#endif // JSON
+
+  memset(&sAcq, 0, sizeof sAcq);
+  for (i = 0; i < n; i++) {
+    ringToAcq(&rs[i], &sAcq);
+    historySample(sess, &sAcq, ch, i, reply);
+  }
+
+#ifdef JSON
+  if (sess->proto != PROTO_BINARY) {
+    replyf(sess, reply, "\n],\n\"id\":%u, \"trigger\":%u", info.id, info.cond.pre);
+    if (from + n < info.cond.pre + info.cond.post)
+      replyf(sess, reply, ", \"next\":%ld", from + n);
+    replyf(sess, reply, "\n}\n");
+  }
+#endif // JSON
+
+  return CMD_CONT;
+}
+
+// Index of name in n names, -1 if it is not there or NULL
+static int nameIndex(const char *name, const char **names, int n)
+{
+  int i;
+
+  for (i = 0; name != NULL && i < n; i++)
+    if (!strcmp(name, names[i]))
+      return i;
+
+  return -1;
+}
+
+/* Current LSB of every channel multiplied by scale, as JSON number,
+ * or array of them when server samples more devices */
+static void lsbList(cmd_sess_s *sess, double scale, char *buf, size_t size)
+{
+  acq_sample_s sAcq;
+  int multi = sess->shm->nchan > 1;
+  size_t len;
+  int ch;
+
+  len = snprintf(buf, size, "%s", multi ? "[" : "");
+  for (ch = 0; ch < sess->shm->nchan && len < size; ch++) {
+    acqSnapshot(&sess->shm->chan[ch], &sAcq);
+    len += snprintf(buf + len, size - len, "%s%g",
+		    (ch == 0) ? "" : ",", scale * sAcq.conf.currLsbA);
+  }
+  if (len < size)
+    snprintf(buf + len, size - len, "%s", multi ? "]" : "");
+}
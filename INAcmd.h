@@ -0,0 +1,78 @@
+/*****************************************************************
+ * Title    : INAcmd.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Client command set of INA219 server, shared by
+ *            fork and epoll server modes
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INACMD_H
+#define INACMD_H
+
+/************************** Includes ****************************/
+#include <stddef.h>
+#include "INAacq.h"
+
+/************ Global Symbolic Constant Definitions **************/
+
+// Return values of cmdExec()
+#define CMD_CONT  0             // Reply sent, keep connection open
+#define CMD_EXIT  1             // Client asked to close connection
+#define CMD_FAIL  2             // Error reply sent, close connection
+
+// Enough room for any single reply of cmdExec(), "log all" included
+#define CMD_REPLY_SIZE 4096
+
+// Reply formats of "proto" command
+#define PROTO_JSON    0
+#define PROTO_BINARY  1
+
+// Fields pushed by "stream" command
+#define STREAM_VOLTAGE  0x01
+#define STREAM_CURRENT  0x02
+
+// Slowest push rate of "stream", period still fits streamPeriodNs
+#define STREAM_MIN_HZ   0.001
+
+// Samples of logged history in one reply, "log <ch> <from> [count]"
+#define LOG_PAGE_DEF    16
+#define LOG_PAGE_MAX    32
+
+/* Rows of downsampled history in one reply, the longest ones still fit
+ * in CMD_REPLY_SIZE */
+#define HISTORY_PAGE    30
+
+// Logged samples "report" converts at once and reads in one reply
+#define REPORT_BLOCK    1024
+#define REPORT_PAGE     (64 * REPORT_BLOCK)
+
+/**************** New Global Types Definitions ******************/
+
+// Per-connection state of command processing
+typedef struct cmd_sess {
+  acq_shared_s *shm;            // Where samples are taken from
+  double realBusVoltVal;        // Last converted bus voltage
+  long long streamPeriodNs;     // Push period, 0 when not streaming
+  long long streamNextNs;       // CLOCK_MONOTONIC time of next push
+  int streamFields;             // STREAM_* fields pushed
+  int streamChan;               // Channel samples are pushed of
+  int proto;                    // PROTO_* format of replies
+} cmd_sess_s;
+
+/* Output buffer commands append their replies to. Binary replies may
+ * contain zero bytes, so length is kept instead of terminating NUL */
+typedef struct cmd_reply {
+  char *buf;
+  size_t size;
+  size_t len;
+} cmd_reply_s;
+
+/************** Global Functions Prototype Declarations *********/
+
+void cmdInit(cmd_sess_s *sess, acq_shared_s *shm);
+void cmdSetLogDir(const char *dir);
+int cmdExec(cmd_sess_s *sess, char *cmd, cmd_reply_s *reply);
+long long cmdStreamDue(cmd_sess_s *sess);
+int cmdStreamPush(cmd_sess_s *sess, cmd_reply_s *reply);
+
+#endif // INACMD_H
@@ -0,0 +1,255 @@
+/*****************************************************************
+ * Title    : INAconf.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Parsing of INA219 settings given as "key value"
+ *            pairs and derivation of calibration register from
+ *            shunt resistance and maximum expected current
+ *            (INA219 datasheet, 8.5.1)
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "INAconf.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+// Fixed scaling constant of calibration equation
+#define CAL_SCALE     0.04096
+
+// Highest calibration value, bit 0 of register is not used
+#define CAL_MAX       0xfffe
+
+/************ Static global Variable Definitions ****************/
+
+// Operating mode names, index is MODE field value
+static const char *modeName[] = {
+  "off", "shunt-trig", "bus-trig", "trig",
+  "adc-off", "shunt-cont", "bus-cont", "cont"
+};
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static int adcParse(const char *val);
+static void calibSet(ina_conf_s *conf);
+
+/**************** Global Functions Definitions ******************/
+
+/* Configuration register value as set at startup and calibration
+ * server always used, 0x1400 with 0.1 ohm shunt */
+void confDefault(ina_conf_s *conf, uint16_t confRegVal)
+{
+  conf->confRegVal = confRegVal;
+  conf->calibRegVal = CONF_DEF_CALIB;
+  conf->rshuntOhm = CONF_DEF_RSHUNT;
+  conf->currLsbA = CAL_SCALE / (conf->calibRegVal * conf->rshuntOhm);
+  conf->currLsbPa = confLsbPa(conf->currLsbA);
+  conf->imaxA = conf->currLsbA * 32768;
+  conf->imaxFixed = 0;
+}
+
+/* Current LSB in pA, rounded. Even the smallest LSB calibration gives
+ * is millions of pA, so integer current keeps the precision of double */
+int64_t confLsbPa(double lsbA)
+{
+  return llround(lsbA * 1e12);
+}
+
+/* Apply "key value" pairs of args to conf. Keys are
+ *   mode   off|shunt-trig|bus-trig|trig|adc-off|shunt-cont|bus-cont|cont
+ *   sadc, badc, adc (both)   9bit|10bit|11bit|12bit or averaged
+ *          samples 1|2|4|8|16|32|64|128
+ *   pga    1|2|4|8          shunt range 40, 80, 160, 320 mV
+ *   brng   16|32            bus range in V
+ *   rshunt <ohm>, imax <A>  calibration is derived from these
+ * Imax never given follows full shunt range when pga or rshunt
+ * change, given one is only cut down to it when it no longer fits.
+ * On error conf is left untouched, message is put in err and -1 is
+ * returned */
+int confParse(ina_conf_s *conf, char *args, char *err, size_t errSize)
+{
+  ina_conf_s next = *conf;
+  char *key, *val, *end, *save;
+  double num;
+  long long rangeUv;
+  int adc, i, imaxSet = 0;
+
+  for (key = strtok_r(args, " \t", &save); key != NULL;
+       key = strtok_r(NULL, " \t", &save)) {
+
+    val = strtok_r(NULL, " \t", &save);
+    if (val == NULL) {
+      snprintf(err, errSize, "Missing value of '%.32s'", key);
+      return -1;
+    }
+
+    if (!strcmp(key, "mode")) {
+      for (i = 0; i <= CONF_MODE_MASK; i++)
+	if (!strcmp(val, modeName[i]))
+	  break;
+      if (i > CONF_MODE_MASK)
+	goto badValue;
+      next.confRegVal = (next.confRegVal & ~CONF_MODE_MASK) | i;
+    }
+    else if (!strcmp(key, "sadc") || !strcmp(key, "badc") || !strcmp(key, "adc")) {
+      if ((adc = adcParse(val)) == -1)
+	goto badValue;
+      if (key[0] != 'b')
+	next.confRegVal = (next.confRegVal & ~(CONF_ADC_MASK << CONF_SADC_SHIFT)) |
+	  adc << CONF_SADC_SHIFT;
+      if (key[0] != 's')
+	next.confRegVal = (next.confRegVal & ~(CONF_ADC_MASK << CONF_BADC_SHIFT)) |
+	  adc << CONF_BADC_SHIFT;
+    }
+    else if (!strcmp(key, "pga")) {
+      num = strtod(val, &end);
+      for (i = 0; i <= CONF_PGA_MASK; i++)
+	if (*end == '\0' && num == 1 << i)
+	  break;
+      if (i > CONF_PGA_MASK)
+	goto badValue;
+      next.confRegVal = (next.confRegVal & ~(CONF_PGA_MASK << CONF_PGA_SHIFT)) |
+	i << CONF_PGA_SHIFT;
+    }
+    else if (!strcmp(key, "brng")) {
+      if (!strcmp(val, "16"))
+	next.confRegVal &= ~CONF_BRNG;
+      else if (!strcmp(val, "32"))
+	next.confRegVal |= CONF_BRNG;
+      else
+	goto badValue;
+    }
+    else if (!strcmp(key, "rshunt") || !strcmp(key, "imax")) {
+      num = strtod(val, &end);
+      if (*end != '\0' || !(num > 0.0))
+	goto badValue;
+      if (key[0] == 'r')
+	next.rshuntOhm = num;
+      else {
+	next.imaxA = num;
+	next.imaxFixed = imaxSet = 1;
+      }
+      calibSet(&next);
+    }
+    else {
+      snprintf(err, errSize, "Unknown key '%.32s', valid are 'mode', 'sadc', "
+	       "'badc', 'adc', 'pga', 'brng', 'rshunt', 'imax'", key);
+      return -1;
+    }
+    continue;
+
+  badValue:
+    snprintf(err, errSize, "Invalid value '%.32s' of '%.32s'", val, key);
+    return -1;
+  }
+
+  // Compared in uV, full-scale imax times rshunt is not exact in double
+  rangeUv = (long long)CONF_SHUNT_RANGE_UV * confPgaGain(&next);
+  if (!imaxSet &&
+      ((!next.imaxFixed && (next.rshuntOhm != conf->rshuntOhm ||
+			    confPgaGain(&next) != confPgaGain(conf))) ||
+       llround(next.imaxA * next.rshuntOhm * 1e6) > rangeUv)) {
+    next.imaxA = rangeUv / 1e6 / next.rshuntOhm;
+    next.imaxFixed = 0;
+    calibSet(&next);
+  }
+
+  if (next.calibRegVal == 0) {
+    snprintf(err, errSize, "imax %g A is too big for %g ohm shunt",
+	     next.imaxA, next.rshuntOhm);
+    return -1;
+  }
+  if (imaxSet && llround(next.imaxA * next.rshuntOhm * 1e6) > rangeUv) {
+    snprintf(err, errSize, "imax %g A makes %g mV on shunt, above %lld mV range of pga %d",
+	     next.imaxA, next.imaxA * next.rshuntOhm * 1000, rangeUv / 1000,
+	     confPgaGain(&next));
+    return -1;
+  }
+
+  *conf = next;
+  return 0;
+}
+
+/* True in triggered modes, where every conversion has to be started
+ * by writing configuration register */
+int confTriggered(const ina_conf_s *conf)
+{
+  unsigned int mode = conf->confRegVal & CONF_MODE_MASK;
+
+  return !(mode & CONF_MODE_CONT) && (mode & (CONF_MODE_SHUNT | CONF_MODE_BUS));
+}
+
+const char *confModeName(const ina_conf_s *conf)
+{
+  return modeName[conf->confRegVal & CONF_MODE_MASK];
+}
+
+/* Name of ADC setting at "shift" (CONF_SADC_SHIFT, CONF_BADC_SHIFT)
+ * as accepted by confParse() */
+const char *confAdcName(const ina_conf_s *conf, int shift, char *buf, size_t size)
+{
+  unsigned int adc = (conf->confRegVal >> shift) & CONF_ADC_MASK;
+
+  if (adc & 0x8)
+    snprintf(buf, size, "%d", 1 << (adc & 0x7));
+  else
+    snprintf(buf, size, "%dbit", 9 + (adc & 0x3));
+
+  return buf;
+}
+
+// PGA gain divider 1, 2, 4 or 8
+int confPgaGain(const ina_conf_s *conf)
+{
+  return 1 << ((conf->confRegVal >> CONF_PGA_SHIFT) & CONF_PGA_MASK);
+}
+
+// Bus voltage range in V
+int confBusRange(const ina_conf_s *conf)
+{
+  return (conf->confRegVal & CONF_BRNG) ? 32 : 16;
+}
+
+/***************** Local Functions Definitions ******************/
+
+// ADC field value of "9bit".."12bit" or number of samples, -1 if invalid
+static int adcParse(const char *val)
+{
+  char *end;
+  long n;
+  int i;
+
+  n = strtol(val, &end, 10);
+  if (!strcmp(end, "bit") && n >= 9 && n <= 12)
+    return n - 9;
+
+  if (*end != '\0')
+    return -1;
+  for (i = 0; i < 8; i++)
+    if (n == 1 << i)
+      return 0x8 | i;
+
+  return -1;
+}
+
+/* Calibration register from imax and rshunt, current LSB is taken
+ * back from the register value. Leaves calibRegVal 0 if imax is too
+ * big to be calibrated for */
+static void calibSet(ina_conf_s *conf)
+{
+  double cal;
+
+  cal = CAL_SCALE / (conf->imaxA / 32768 * conf->rshuntOhm);
+  if (cal > CAL_MAX)
+    cal = CAL_MAX;
+
+  conf->calibRegVal = (uint16_t)cal & CAL_MAX;
+  if (conf->calibRegVal != 0) {
+    conf->currLsbA = CAL_SCALE / (conf->calibRegVal * conf->rshuntOhm);
+    conf->currLsbPa = confLsbPa(conf->currLsbA);
+  }
+}
@@ -0,0 +1,65 @@
+/*****************************************************************
+ * Title    : INAconf.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : INA219 configuration and calibration, as set by "-c"
+ *            startup option and "config" command
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INACONF_H
+#define INACONF_H
+
+/************************** Includes ****************************/
+#include <stdint.h>
+#include <stddef.h>
+
+/************ Global Symbolic Constant Definitions **************/
+
+// Configuration register fields (INA219 datasheet, table 3)
+#define CONF_MODE_MASK   0x0007
+#define CONF_SADC_SHIFT  3
+#define CONF_BADC_SHIFT  7
+#define CONF_ADC_MASK    0x000f
+#define CONF_PGA_SHIFT   11
+#define CONF_PGA_MASK    0x0003
+#define CONF_BRNG        0x2000
+
+// Bits of operating mode
+#define CONF_MODE_SHUNT  0x1
+#define CONF_MODE_BUS    0x2
+#define CONF_MODE_CONT   0x4
+
+// Values startup configuration of server always had
+#define CONF_DEF_CALIB   0x1400
+#define CONF_DEF_RSHUNT  0.1
+
+// Full-scale shunt voltage of pga 1, doubles with every pga step
+#define CONF_SHUNT_RANGE_UV  40000
+
+/**************** New Global Types Definitions ******************/
+
+/* Register values and what calibration was derived from. currLsbA
+ * follows from calibRegVal actually written, which is rounded down,
+ * so it may differ a bit from imaxA / 32768 */
+typedef struct ina_conf {
+  uint16_t confRegVal;
+  uint16_t calibRegVal;
+  double rshuntOhm;             // Shunt resistance
+  double imaxA;                 // Maximum expected current
+  int imaxFixed;                // imaxA was given, else it follows pga
+  double currLsbA;              // Current register LSB, power LSB is 20x
+  int64_t currLsbPa;            // currLsbA in pA, for fixed-point conversion
+} ina_conf_s;
+
+/************** Global Functions Prototype Declarations *********/
+
+void confDefault(ina_conf_s *conf, uint16_t confRegVal);
+int confParse(ina_conf_s *conf, char *args, char *err, size_t errSize);
+int confTriggered(const ina_conf_s *conf);
+const char *confModeName(const ina_conf_s *conf);
+int64_t confLsbPa(double lsbA);
+const char *confAdcName(const ina_conf_s *conf, int shift, char *buf, size_t size);
+int confPgaGain(const ina_conf_s *conf);
+int confBusRange(const ina_conf_s *conf);
+
+#endif // INACONF_H
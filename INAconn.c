@@ -0,0 +1,323 @@
+/*****************************************************************
+ * Title    : INAconn.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Buffered client connection of INA219 server. Splits
+ *            input into command lines, collects replies and pushed
+ *            stream samples into output buffer
+ * Version  : 1.0
+ ****************************************************************/
+#define _GNU_SOURCE               // ppoll()
+
+/************************** Includes ****************************/
+#include <sys/socket.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <time.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/error_functions.h"
+#include "INAacq.h"
+#include "INAcmd.h"
+#include "INAmetrics.h"
+#include "INAconn.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+#define CONN_BATCH     "batch"
+#define CONN_BATCH_SEP ';'
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static int connBatch(conn_s *conn, const char *cmd, size_t lineOff,
+		     size_t lineLen, size_t *inOff);
+
+/**************** Global Functions Definitions ******************/
+
+/* Prepare connection on accepted socket fd and make the socket
+ * non-blocking. Returns -1 if socket could not be set up */
+int connInit(conn_s *conn, int fd, acq_shared_s *shm)
+{
+  int flags;
+
+  flags = fcntl(fd, F_GETFL);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+    return -1;
+
+  conn->fd = fd;
+  conn->closing = 0;
+  conn->status = CMD_CONT;
+  conn->inLen = 0;
+  conn->outOff = conn->outLen = 0;
+  conn->events = 0;
+  conn->prev = conn->next = NULL;
+  conn->listed = 0;
+  conn->openNs = metNow();
+  cmdInit(&conn->sess, shm);
+  metAdd(MET_CONN_ACCEPTED, 1);
+
+  return 0;
+}
+
+// Read whatever client sent, as much as fits in input buffer
+void connRead(conn_s *conn)
+{
+  ssize_t numRead;
+
+  while (!conn->closing && conn->inLen < sizeof conn->in) {
+    numRead = read(conn->fd, conn->in + conn->inLen,
+		   sizeof conn->in - conn->inLen);
+
+    if (numRead > 0) {
+      conn->inLen += numRead;
+      metAdd(MET_BYTES_IN, numRead);
+
+      /* Short read drained the socket, poll is level-triggered and
+	 reports the rest, so read() just to get EAGAIN is spared */
+      if (conn->inLen < sizeof conn->in)
+	break;
+    }
+    else if (numRead == 0) {           // Client closed its end
+      conn->closing = 1;
+    }
+    else if (errno == EINTR) {
+      continue;
+    }
+    else {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+	conn->closing = 1;
+      break;
+    }
+  }
+}
+
+/* Execute every complete command line in input buffer, as long as
+ * there is room for its reply in output buffer. Pipelined lines are
+ * consumed in place and input is moved down once, their replies go
+ * out together with single write() of connFlush() */
+void connProcess(conn_s *conn)
+{
+  char cmd[BUF_SIZE];
+  cmd_reply_s reply;
+  char *line, *eol;
+  size_t inOff = 0, lineLen, cmdLen, left;
+  int ret;
+
+  while (inOff < conn->inLen && conn->status == CMD_CONT) {
+
+    // Make room for reply, if socket does not take it rest of input waits
+    if (sizeof conn->out - conn->outLen < CMD_REPLY_SIZE) {
+      connFlush(conn);
+      if (sizeof conn->out - conn->outLen < CMD_REPLY_SIZE)
+	break;
+    }
+
+    /* Split off one line the way fgets() would do, overlong or last
+       unterminated line is taken as it is */
+    line = conn->in + inOff;
+    left = conn->inLen - inOff;
+    eol = memchr(line, '\n', left);
+    if (eol != NULL)
+      lineLen = eol - line + 1;
+    else if (left == sizeof conn->in || conn->closing)
+      lineLen = left;
+    else
+      break;                          // Wait for the rest of line
+
+    cmdLen = lineLen < sizeof cmd ? lineLen : sizeof cmd - 1;
+    memcpy(cmd, line, cmdLen);
+    cmd[cmdLen] = '\0';
+    cmd[strcspn(cmd, "\r\n")] = '\0';
+    lineLen = cmdLen;
+
+    // Batch turns into its command lines, which are taken next
+    if (connBatch(conn, cmd, inOff, lineLen, &inOff))
+      continue;
+
+    reply.buf = conn->out;
+    reply.size = sizeof conn->out;
+    reply.len = conn->outLen;
+    ret = cmdExec(&conn->sess, cmd, &reply);
+    conn->outLen = reply.len;
+
+    inOff += lineLen;
+
+    if (ret != CMD_CONT) {
+      conn->status = ret;
+      conn->closing = 1;
+      conn->inLen = inOff = 0;
+    }
+  }
+
+  if (inOff > 0) {
+    memmove(conn->in, conn->in + inOff, conn->inLen - inOff);
+    conn->inLen -= inOff;
+  }
+}
+
+/* Push stream sample if one is due. Live data are not worth queueing,
+ * so sample is dropped when client does not keep up with reading */
+void connStream(conn_s *conn)
+{
+  char buf[CMD_REPLY_SIZE];
+  cmd_reply_s reply = { buf, sizeof buf, 0 };
+  int ret;
+
+  if (conn->status != CMD_CONT)
+    return;
+
+  ret = cmdStreamPush(&conn->sess, &reply);
+
+  if (reply.len > 0 && reply.len <= sizeof conn->out - conn->outLen) {
+    memcpy(conn->out + conn->outLen, buf, reply.len);
+    conn->outLen += reply.len;
+  }
+
+  if (ret != CMD_CONT) {
+    conn->status = ret;
+    conn->closing = 1;
+    conn->inLen = 0;
+  }
+}
+
+// Write as much of pending output as socket takes
+void connFlush(conn_s *conn)
+{
+  ssize_t numWritten;
+  long long t0;
+
+  while (conn->outOff < conn->outLen) {
+    t0 = metNow();
+    numWritten = write(conn->fd, conn->out + conn->outOff,
+		       conn->outLen - conn->outOff);
+    metObserve(MET_SOCK_WRITE, metNow() - t0);
+    if (numWritten == -1) {
+      if (errno == EINTR)
+	continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+	conn->closing = 1;            // Nobody to write to anymore
+	conn->outOff = conn->outLen;
+      }
+      else
+	metAdd(MET_WRITE_AGAIN, 1);
+      break;
+    }
+
+    conn->outOff += numWritten;
+    metAdd(MET_BYTES_OUT, numWritten);
+  }
+
+  if (conn->outOff == conn->outLen)
+    conn->outOff = conn->outLen = 0;
+}
+
+// Account closed connection, before its socket is closed
+void connDone(conn_s *conn)
+{
+  metObserve(MET_CONN_LIFE, metNow() - conn->openNs);
+  metAdd(MET_CONN_CLOSED, 1);
+}
+
+/* Serve one client until it goes away, used by forked child.
+ * Returns exit status for the child */
+int connServe(int csck, acq_shared_s *shm)
+{
+  static conn_s conn;           // Too big for the stack of child
+  struct pollfd pfd;
+  struct timespec timeout, *tmo;
+  long long due, now;
+
+  if (connInit(&conn, csck, shm) == -1) {
+    errMsg("connInit(csck)");
+    return EXIT_FAILURE;
+  }
+
+  while (!conn.closing || conn.outOff < conn.outLen) {
+
+    // Sleep until client talks, socket drains or stream sample is due
+    pfd.fd = csck;
+    pfd.events = 0;
+    if (!conn.closing && conn.inLen < sizeof conn.in)
+      pfd.events |= POLLIN;
+    if (conn.outOff < conn.outLen)
+      pfd.events |= POLLOUT;
+
+    tmo = NULL;
+    due = cmdStreamDue(&conn.sess);
+    if (due >= 0) {
+      now = acqNowNs();
+      due = due > now ? due - now : 0;
+      timeout.tv_sec = due / 1000000000LL;
+      timeout.tv_nsec = due % 1000000000LL;
+      tmo = &timeout;
+    }
+
+    if (ppoll(&pfd, 1, tmo, NULL) == -1) {
+      if (errno == EINTR)
+	continue;
+      errMsg("ppoll(csck)");
+      break;
+    }
+
+    if (pfd.revents & POLLOUT)
+      connFlush(&conn);
+    if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+      connRead(&conn);
+
+    connStream(&conn);
+    connProcess(&conn);
+    connFlush(&conn);
+  }
+
+  connDone(&conn);
+  shutdown(csck, SHUT_RDWR);
+  close(csck);
+
+  return conn.status == CMD_FAIL ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/***************** Local Functions Definitions ******************/
+
+/* If cmd is "batch cmd;cmd;...", replace its line at lineOff in input
+ * buffer by one line per non-empty command and set *inOff to the first
+ * of them. Commands are never longer than the batch line, so they fit
+ * in its place. Returns 0 and leaves input alone for any other line and
+ * for batch without commands, which cmdExec() answers */
+static int connBatch(conn_s *conn, const char *cmd, size_t lineOff,
+		     size_t lineLen, size_t *inOff)
+{
+  char lines[BUF_SIZE];
+  const char *p, *end;
+  size_t len = 0, n;
+
+  p = cmd + strspn(cmd, " \t");
+  n = strlen(CONN_BATCH);
+  if (strncmp(p, CONN_BATCH, n) != 0 || (p[n] != ' ' && p[n] != '\t'))
+    return 0;
+
+  for (p += n; *p != '\0'; p = *end ? end + 1 : end) {
+    end = strchr(p, CONN_BATCH_SEP);
+    if (end == NULL)
+      end = p + strlen(p);
+
+    // Trim blanks around command
+    p += strspn(p, " \t");
+    for (n = end - p; n > 0 && (p[n - 1] == ' ' || p[n - 1] == '\t'); n--)
+      ;
+    if (n == 0)
+      continue;
+
+    memcpy(lines + len, p, n);
+    len += n;
+    lines[len++] = '\n';
+  }
+
+  /* "batch" and its blank are gone, so lines are one byte shorter than
+     cmd at least, even with newline the last command did not have */
+  if (len == 0 || len > lineLen)
+    return 0;
+
+  *inOff = lineOff + lineLen - len;
+  memcpy(conn->in + *inOff, lines, len);
+
+  return 1;
+}
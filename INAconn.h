@@ -0,0 +1,54 @@
+/*****************************************************************
+ * Title    : INAconn.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Buffered client connection of INA219 server, used
+ *            by both fork and epoll server modes
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INACONN_H
+#define INACONN_H
+
+/************************** Includes ****************************/
+#include <stdint.h>
+#include <stddef.h>
+#include "INAacq.h"
+#include "INAcmd.h"
+
+/************ Global Symbolic Constant Definitions **************/
+
+#ifndef BUF_SIZE          /* Allow "gcc -D" to override definition */
+#define BUF_SIZE 1024
+#endif
+
+#define CONN_OUT_SIZE  (4 * CMD_REPLY_SIZE)
+
+/**************** New Global Types Definitions ******************/
+
+// State of one client connection, socket is always non-blocking
+typedef struct conn {
+  int fd;
+  int closing;                  // Close once output is flushed
+  int status;                   // CMD_* which made connection close
+  size_t inLen;                 // Bytes waiting in input buffer
+  size_t outOff, outLen;        // Unsent part of output buffer
+  uint32_t events;              // Events watched by epoll mode
+  struct conn *prev, *next;     // Streaming connections of epoll mode
+  int listed;                   // Connection is in streaming list
+  long long openNs;             // CLOCK_MONOTONIC time of connInit()
+  cmd_sess_s sess;
+  char in[BUF_SIZE];
+  char out[CONN_OUT_SIZE];
+} conn_s;
+
+/************** Global Functions Prototype Declarations *********/
+
+int connInit(conn_s *conn, int fd, acq_shared_s *shm);
+void connRead(conn_s *conn);
+void connProcess(conn_s *conn);
+void connStream(conn_s *conn);
+void connFlush(conn_s *conn);
+void connDone(conn_s *conn);
+int connServe(int csck, acq_shared_s *shm);
+
+#endif // INACONN_H
@@ -0,0 +1,228 @@
+/*****************************************************************
+ * Title    : INAconv.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Conversion of blocks of raw INA219 registers to
+ *            physical units. Kernel is chosen at compile time by
+ *            target instruction set, eight samples a step, the
+ *            rest of block goes through scalar conversion
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include "INAacq.h"
+#include "INAconv.h"
+
+/* "gcc -DCONV_NO_SIMD" builds scalar kernel only, e.g. to compare
+ * results of vectorized one with it */
+#ifndef CONV_NO_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CONV_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CONV_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CONV_NEON
+#endif
+#endif // CONV_NO_SIMD
+
+/************ Local Symbolic Constant Definitions ***************/
+
+// Samples of one vector step
+#define CONV_STEP    8
+
+// Register bits of CONV_F_* flags
+#define CONV_F_MASK  (CONV_F_OVF | CONV_F_CNVR)
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static size_t convVector(const int16_t *shunt, const int16_t *bus,
+			 const int16_t *curr, size_t n, float currLsbA,
+			 conv_out_s *out);
+
+/**************** Global Functions Definitions ******************/
+
+/* Convert n samples of raw shunt, bus and current registers taken
+ * with current LSB currLsbA. Every kernel sums load voltage in uV
+ * as integer and scales it once, so all of them give the same floats */
+void convBlock(const int16_t *shunt, const int16_t *bus, const int16_t *curr,
+	       size_t n, float currLsbA, conv_out_s *out)
+{
+  int32_t mag, uv;
+  uint16_t b;
+  size_t i;
+
+  for (i = convVector(shunt, bus, curr, n, currLsbA, out); i < n; i++) {
+    mag = shunt[i] < 0 ? -(int32_t)shunt[i] : shunt[i];
+    b = (uint16_t)bus[i];
+    uv = (b >> 3) * ACQ_BUS_LSB_UV + mag * ACQ_SHUNT_LSB_UV;
+
+    out->voltV[i] = (float)uv * 1e-6f;
+    out->shuntMv[i] = (float)(mag * ACQ_SHUNT_LSB_UV) * 1e-3f;
+    out->currA[i] = (float)curr[i] * currLsbA;
+    out->flags[i] = b & CONV_F_MASK;
+  }
+}
+
+// Instruction set convBlock() was built for, for reports
+const char *convKernel(void)
+{
+#if defined(CONV_AVX2)
+  return "avx2";
+#elif defined(CONV_SSE2)
+  return "sse2";
+#elif defined(CONV_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+/***************** Local Functions Definitions ******************/
+
+#if defined(CONV_AVX2)
+
+/* Eight samples a step in 32 bit lanes. Returns number of samples
+ * converted, the rest is left to the caller */
+static size_t convVector(const int16_t *shunt, const int16_t *bus,
+			 const int16_t *curr, size_t n, float currLsbA,
+			 conv_out_s *out)
+{
+  const __m256i busLsb = _mm256_set1_epi32(ACQ_BUS_LSB_UV);
+  const __m256i shuntLsb = _mm256_set1_epi32(ACQ_SHUNT_LSB_UV);
+  const __m256 uvScale = _mm256_set1_ps(1e-6f);
+  const __m256 mvScale = _mm256_set1_ps(1e-3f);
+  const __m256 lsb = _mm256_set1_ps(currLsbA);
+  const __m128i flagMask = _mm_set1_epi16(CONV_F_MASK);
+  __m128i s16, b16, c16;
+  __m256i suv, uv;
+  size_t i;
+
+  for (i = 0; i + CONV_STEP <= n; i += CONV_STEP) {
+    s16 = _mm_loadu_si128((const __m128i *)(shunt + i));
+    b16 = _mm_loadu_si128((const __m128i *)(bus + i));
+    c16 = _mm_loadu_si128((const __m128i *)(curr + i));
+
+    // Sign extended shunt is made positive, bus is unsigned
+    suv = _mm256_mullo_epi32(_mm256_abs_epi32(_mm256_cvtepi16_epi32(s16)),
+			     shuntLsb);
+    uv = _mm256_mullo_epi32(_mm256_cvtepu16_epi32(_mm_srli_epi16(b16, 3)),
+			    busLsb);
+    uv = _mm256_add_epi32(uv, suv);
+
+    _mm256_storeu_ps(out->voltV + i, _mm256_mul_ps(_mm256_cvtepi32_ps(uv), uvScale));
+    _mm256_storeu_ps(out->shuntMv + i, _mm256_mul_ps(_mm256_cvtepi32_ps(suv), mvScale));
+    _mm256_storeu_ps(out->currA + i,
+		     _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(c16)), lsb));
+    _mm_storel_epi64((__m128i *)(out->flags + i),
+		     _mm_packus_epi16(_mm_and_si128(b16, flagMask), _mm_setzero_si128()));
+  }
+
+  return i;
+}
+
+#elif defined(CONV_SSE2)
+
+/* Two halves of four 32 bit lanes a step. SSE2 has neither 32 bit
+ * absolute value nor multiply, both are made of shifts and adds */
+static size_t convVector(const int16_t *shunt, const int16_t *bus,
+			 const int16_t *curr, size_t n, float currLsbA,
+			 conv_out_s *out)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i busLsb = _mm_set1_epi32(ACQ_BUS_LSB_UV);
+  const __m128 uvScale = _mm_set1_ps(1e-6f);
+  const __m128 mvScale = _mm_set1_ps(1e-3f);
+  const __m128 lsb = _mm_set1_ps(currLsbA);
+  const __m128i flagMask = _mm_set1_epi16(CONV_F_MASK);
+  __m128i s16, b16, b3, c16, s32[2], c32[2], b32[2], sgn, suv, uv;
+  size_t i;
+  int h;
+
+  for (i = 0; i + CONV_STEP <= n; i += CONV_STEP) {
+    s16 = _mm_loadu_si128((const __m128i *)(shunt + i));
+    b16 = _mm_loadu_si128((const __m128i *)(bus + i));
+    c16 = _mm_loadu_si128((const __m128i *)(curr + i));
+
+    // Sign extension moves value to upper half and shifts it back
+    s32[0] = _mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16);
+    s32[1] = _mm_srai_epi32(_mm_unpackhi_epi16(s16, s16), 16);
+    c32[0] = _mm_srai_epi32(_mm_unpacklo_epi16(c16, c16), 16);
+    c32[1] = _mm_srai_epi32(_mm_unpackhi_epi16(c16, c16), 16);
+    b3 = _mm_srli_epi16(b16, 3);
+    b32[0] = _mm_unpacklo_epi16(b3, zero);
+    b32[1] = _mm_unpackhi_epi16(b3, zero);
+
+    for (h = 0; h < 2; h++) {
+      sgn = _mm_srai_epi32(s32[h], 31);
+      suv = _mm_sub_epi32(_mm_xor_si128(s32[h], sgn), sgn);
+      // x * 10 = x * 8 + x * 2
+      suv = _mm_add_epi32(_mm_slli_epi32(suv, 3), _mm_slli_epi32(suv, 1));
+      // Bus value is zero extended, pairs (b, 0) * (4000, 0) give b * 4000
+      uv = _mm_add_epi32(_mm_madd_epi16(b32[h], busLsb), suv);
+
+      _mm_storeu_ps(out->voltV + i + 4 * h, _mm_mul_ps(_mm_cvtepi32_ps(uv), uvScale));
+      _mm_storeu_ps(out->shuntMv + i + 4 * h, _mm_mul_ps(_mm_cvtepi32_ps(suv), mvScale));
+      _mm_storeu_ps(out->currA + i + 4 * h, _mm_mul_ps(_mm_cvtepi32_ps(c32[h]), lsb));
+    }
+
+    _mm_storel_epi64((__m128i *)(out->flags + i),
+		     _mm_packus_epi16(_mm_and_si128(b16, flagMask), zero));
+  }
+
+  return i;
+}
+
+#elif defined(CONV_NEON)
+
+// Two halves of four 32 bit lanes a step
+static size_t convVector(const int16_t *shunt, const int16_t *bus,
+			 const int16_t *curr, size_t n, float currLsbA,
+			 conv_out_s *out)
+{
+  int16x8_t s16, c16;
+  uint16x8_t b16;
+  int32x4_t suv, uv;
+  size_t i;
+
+  for (i = 0; i + CONV_STEP <= n; i += CONV_STEP) {
+    s16 = vld1q_s16(shunt + i);
+    b16 = vreinterpretq_u16_s16(vld1q_s16(bus + i));
+    c16 = vld1q_s16(curr + i);
+
+    suv = vmulq_n_s32(vabsq_s32(vmovl_s16(vget_low_s16(s16))), ACQ_SHUNT_LSB_UV);
+    uv = vaddq_s32(vreinterpretq_s32_u32(vmulq_n_u32(vmovl_u16(vget_low_u16(vshrq_n_u16(b16, 3))),
+						     ACQ_BUS_LSB_UV)), suv);
+    vst1q_f32(out->voltV + i, vmulq_n_f32(vcvtq_f32_s32(uv), 1e-6f));
+    vst1q_f32(out->shuntMv + i, vmulq_n_f32(vcvtq_f32_s32(suv), 1e-3f));
+    vst1q_f32(out->currA + i,
+	      vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(c16))), currLsbA));
+
+    suv = vmulq_n_s32(vabsq_s32(vmovl_s16(vget_high_s16(s16))), ACQ_SHUNT_LSB_UV);
+    uv = vaddq_s32(vreinterpretq_s32_u32(vmulq_n_u32(vmovl_u16(vget_high_u16(vshrq_n_u16(b16, 3))),
+						     ACQ_BUS_LSB_UV)), suv);
+    vst1q_f32(out->voltV + i + 4, vmulq_n_f32(vcvtq_f32_s32(uv), 1e-6f));
+    vst1q_f32(out->shuntMv + i + 4, vmulq_n_f32(vcvtq_f32_s32(suv), 1e-3f));
+    vst1q_f32(out->currA + i + 4,
+	      vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(c16))), currLsbA));
+
+    vst1_u8(out->flags + i, vmovn_u16(vandq_u16(b16, vdupq_n_u16(CONV_F_MASK))));
+  }
+
+  return i;
+}
+
+#else
+
+// No vector unit, convBlock() converts everything
+static size_t convVector(const int16_t *shunt, const int16_t *bus,
+			 const int16_t *curr, size_t n, float currLsbA,
+			 conv_out_s *out)
+{
+  (void)shunt; (void)bus; (void)curr; (void)n; (void)currLsbA; (void)out;
+  return 0;
+}
+
+#endif
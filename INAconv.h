@@ -0,0 +1,42 @@
+/*****************************************************************
+ * Title    : INAconv.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Conversion of blocks of raw INA219 registers, kept
+ *            as separate arrays per register, to physical units.
+ *            Vectorized for NEON, SSE2 and AVX2
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INACONV_H
+#define INACONV_H
+
+/************************** Includes ****************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/************ Global Symbolic Constant Definitions **************/
+
+// Flags of bus voltage register, kept in conv_out_s.flags
+#define CONV_F_OVF   0x01       // Math overflow of power or current
+#define CONV_F_CNVR  0x02       // Conversion ready
+
+/**************** New Global Types Definitions ******************/
+
+/* Converted block, element i belongs to raw registers i. Values are
+ * those of acqVoltage(), acqShuntMv() and acqCurrent() to float
+ * precision, current is register times currLsbA in float, while
+ * acqCurrent() scales by currLsbPa */
+typedef struct conv_out {
+  float *voltV;                 // Load voltage, bus plus shunt voltage
+  float *shuntMv;               // Shunt voltage, sign dropped
+  float *currA;                 // Current
+  uint8_t *flags;               // CONV_F_* bits
+} conv_out_s;
+
+/************** Global Functions Prototype Declarations *********/
+
+void convBlock(const int16_t *shunt, const int16_t *bus, const int16_t *curr,
+	       size_t n, float currLsbA, conv_out_s *out);
+const char *convKernel(void);
+
+#endif // INACONV_H
@@ -0,0 +1,172 @@
+/*****************************************************************
+ * Title    : INAenergy.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Table of named energy accumulators described in
+ *            INAenergy.h. Client handlers of any process start,
+ *            read and reset them, integration itself is done by
+ *            acquisition workers
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <string.h>
+#include "../header/tlpi_hdr.h"
+#include "INAenergy.h"
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static void tabLock(energy_tab_s *tab);
+static energy_acc_s *accFind(energy_tab_s *tab, const char *name);
+
+/**************** Global Functions Definitions ******************/
+
+/* Initialize table placed in shared memory, before any client
+ * handler is forked. Client may die holding the mutex, robust mutex
+ * lets the others go on */
+void energyInit(energy_tab_s *tab)
+{
+  pthread_mutexattr_t mtxAttr;
+  int s;
+
+  memset(tab->acc, 0, sizeof tab->acc);
+
+  s = pthread_mutexattr_init(&mtxAttr);
+  if (s != 0)
+    errExitEN(s, "pthread_mutexattr_init");
+  s = pthread_mutexattr_setpshared(&mtxAttr, PTHREAD_PROCESS_SHARED);
+  if (s != 0)
+    errExitEN(s, "pthread_mutexattr_setpshared");
+  s = pthread_mutexattr_setrobust(&mtxAttr, PTHREAD_MUTEX_ROBUST);
+  if (s != 0)
+    errExitEN(s, "pthread_mutexattr_setrobust");
+  s = pthread_mutex_init(&tab->mutex, &mtxAttr);
+  if (s != 0)
+    errExitEN(s, "pthread_mutex_init(energy)");
+  pthread_mutexattr_destroy(&mtxAttr);
+}
+
+/* Names are 1 to ENERGY_NAME_SIZE - 1 letters, digits, '_', '-'
+ * and '.', so they go to JSON reply as they are */
+int energyNameValid(const char *name)
+{
+  size_t len = strlen(name);
+
+  if (len == 0 || len >= ENERGY_NAME_SIZE)
+    return 0;
+
+  return strspn(name, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"0123456789_-.") == len;
+}
+
+/* Start accumulator acc, one of the same name is started over.
+ * Returns -1 if all ENERGY_MAX accumulators are taken */
+int energyStart(energy_tab_s *tab, const energy_acc_s *acc)
+{
+  energy_acc_s *a;
+  int i;
+
+  tabLock(tab);
+  a = accFind(tab, acc->name);
+  for (i = 0; a == NULL && i < ENERGY_MAX; i++)
+    if (tab->acc[i].name[0] == '\0')
+      a = &tab->acc[i];
+  if (a != NULL)
+    *a = *acc;
+  pthread_mutex_unlock(&tab->mutex);
+
+  return (a != NULL) ? 0 : -1;
+}
+
+/* Start accumulator "name" over from given totals, which must be
+ * taken from its channel ch. Returns -1 if there is no such
+ * accumulator on ch, it was stopped or moved meanwhile */
+int energyReset(energy_tab_s *tab, const char *name, int64_t startNs,
+		double energyJ, double chargeC, int ch)
+{
+  energy_acc_s *a;
+  int ret = -1;
+
+  tabLock(tab);
+  a = accFind(tab, name);
+  if (a != NULL && a->ch == ch) {
+    a->startNs = startNs;
+    a->energyJ = energyJ;
+    a->chargeC = chargeC;
+    ret = 0;
+  }
+  pthread_mutex_unlock(&tab->mutex);
+
+  return ret;
+}
+
+// Free accumulator "name", -1 if there is none
+int energyStop(energy_tab_s *tab, const char *name)
+{
+  energy_acc_s *a;
+
+  tabLock(tab);
+  a = accFind(tab, name);
+  if (a != NULL)
+    a->name[0] = '\0';
+  pthread_mutex_unlock(&tab->mutex);
+
+  return (a != NULL) ? 0 : -1;
+}
+
+// Copy accumulator "name" to acc, -1 if there is none
+int energyGet(energy_tab_s *tab, const char *name, energy_acc_s *acc)
+{
+  energy_acc_s *a;
+
+  tabLock(tab);
+  a = accFind(tab, name);
+  if (a != NULL)
+    *acc = *a;
+  pthread_mutex_unlock(&tab->mutex);
+
+  return (a != NULL) ? 0 : -1;
+}
+
+/* Copy all started accumulators to acc, which has room for
+ * ENERGY_MAX of them. Returns their number */
+int energyList(energy_tab_s *tab, energy_acc_s *acc)
+{
+  int i, n = 0;
+
+  tabLock(tab);
+  for (i = 0; i < ENERGY_MAX; i++)
+    if (tab->acc[i].name[0] != '\0')
+      acc[n++] = tab->acc[i];
+  pthread_mutex_unlock(&tab->mutex);
+
+  return n;
+}
+
+/***************** Local Functions Definitions ******************/
+
+/* Lock table mutex. If a client handler died holding it, table is
+ * consistent anyway, every change is a single entry copy */
+static void tabLock(energy_tab_s *tab)
+{
+  int s;
+
+  s = pthread_mutex_lock(&tab->mutex);
+  if (s == EOWNERDEAD)
+    s = pthread_mutex_consistent(&tab->mutex);
+  if (s != 0)
+    errExitEN(s, "pthread_mutex_lock(energy)");
+}
+
+// Started accumulator "name", caller holds the mutex
+static energy_acc_s *accFind(energy_tab_s *tab, const char *name)
+{
+  int i;
+
+  for (i = 0; i < ENERGY_MAX; i++)
+    if (tab->acc[i].name[0] != '\0' &&
+	strcmp(tab->acc[i].name, name) == 0)
+      return &tab->acc[i];
+
+  return NULL;
+}
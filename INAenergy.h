@@ -0,0 +1,55 @@
+/*****************************************************************
+ * Title    : INAenergy.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Named energy and charge accumulators. Acquisition
+ *            worker integrates power and current of every
+ *            conversion into running totals of its channel, an
+ *            accumulator keeps totals it was started at, so its
+ *            value is difference of the two
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INAENERGY_H
+#define INAENERGY_H
+
+/************************** Includes ****************************/
+#include <stdint.h>
+#include <pthread.h>
+
+/************ Global Symbolic Constant Definitions **************/
+
+#define ENERGY_MAX        32     // Accumulators of whole server
+#define ENERGY_NAME_SIZE  32     // Longest name, including '\0'
+
+/**************** New Global Types Definitions ******************/
+
+/* Accumulator started on channel "ch" at sample time startNs, when
+ * totals of the channel were energyJ and chargeC. Free if name is
+ * empty */
+typedef struct energy_acc {
+  char name[ENERGY_NAME_SIZE];
+  int ch;
+  int64_t startNs;              // CLOCK_MONOTONIC ns
+  double energyJ;
+  double chargeC;
+} energy_acc_s;
+
+/* Accumulators shared by all client handlers, "mutex" is robust and
+ * process-shared, initialized by energyInit() */
+typedef struct energy_tab {
+  pthread_mutex_t mutex;
+  energy_acc_s acc[ENERGY_MAX];
+} energy_tab_s;
+
+/************** Global Functions Prototype Declarations *********/
+
+void energyInit(energy_tab_s *tab);
+int energyNameValid(const char *name);
+int energyStart(energy_tab_s *tab, const energy_acc_s *acc);
+int energyReset(energy_tab_s *tab, const char *name, int64_t startNs,
+		double energyJ, double chargeC, int ch);
+int energyStop(energy_tab_s *tab, const char *name);
+int energyGet(energy_tab_s *tab, const char *name, energy_acc_s *acc);
+int energyList(energy_tab_s *tab, energy_acc_s *acc);
+
+#endif // INAENERGY_H
@@ -0,0 +1,363 @@
+/*****************************************************************
+ * Title    : INAepoll.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Single process, non-blocking epoll reactor serving
+ *            all client connections of INA219 server. Alternative
+ *            to fork per connection, memory stays flat no matter
+ *            how many clients are connected. Several reactors may
+ *            run as threads pinned to cores, each on its own
+ *            SO_REUSEPORT listener
+ * Version  : 1.0
+ ****************************************************************/
+#define _GNU_SOURCE               // accept4(), pthread_setaffinity_np()
+
+/************************** Includes ****************************/
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/error_functions.h"
+#include "INAacq.h"
+#include "INAcmd.h"
+#include "INAconn.h"
+#include "INAlocal.h"
+#include "INAmetrics.h"
+#include "INAepoll.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+#define MAX_EVENTS     64
+
+/**************** New Local Types Definitions *******************/
+
+// Reactor thread of epollServeCores()
+typedef struct reactor {
+  pthread_t thr;
+  int ssck;
+  int usck;
+  int cpu;
+  acq_shared_s *shm;
+} reactor_s;
+
+/************ Static global Variable Definitions ****************/
+
+/* Every reactor thread has its own state below, connections never
+ * move between reactors */
+
+/* Epoll data of listening sockets and stream timer, connections
+ * carry pointer to their conn_s */
+static __thread int listenTag, localTag, timerTag;
+
+// Connections with active stream, the only ones timer has to visit
+static __thread conn_s *streamers;
+
+// Absolute time stream timer is armed for, -1 when disarmed
+static __thread long long timerDue = -1;
+
+static reactor_s reactors[EPOLL_MAX_REACTORS];
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static void *reactorRun(void *arg);
+static void reactorPin(int cpu);
+static void connAccept(int epfd, int lsck, int local, acq_shared_s *shm);
+static void connClose(conn_s *conn);
+static void connUpdate(int epfd, conn_s *conn);
+static void streamUnlist(conn_s *conn);
+static void streamRun(int epfd, int tfd);
+
+/**************** Global Functions Definitions ******************/
+
+/* Serve all clients accepted on TCP listening socket ssck and on local
+ * one usck from calling thread, -1 stands for missing listener. Local
+ * listener may be shared by more reactors. Never returns */
+void epollServe(int ssck, int usck, acq_shared_s *shm)
+{
+  struct epoll_event ev;
+  struct epoll_event evlist[MAX_EVENTS];
+  conn_s *conn;
+  uint64_t expirations;
+  int epfd, tfd, ready, j;
+  int flags;
+
+  // Peer closing its end must not kill the whole server
+  if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
+    errExit("signal(SIGPIPE)");
+
+  epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd == -1)
+    errExit("epoll_create1(2)");
+
+  if (ssck != -1) {
+    flags = fcntl(ssck, F_GETFL);
+    if (flags == -1 || fcntl(ssck, F_SETFL, flags | O_NONBLOCK) == -1)
+      errExit("fcntl(ssck, O_NONBLOCK)");
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = &listenTag;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, ssck, &ev) == -1)
+      errExit("epoll_ctl(ssck)");
+  }
+
+  // Only one of reactors sharing local listener is woken per client
+  if (usck != -1) {
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = &localTag;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, usck, &ev) == -1)
+      errExit("epoll_ctl(usck)");
+  }
+
+  // One timer wakes the loop for the earliest due stream sample
+  tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (tfd == -1)
+    errExit("timerfd_create(2)");
+
+  ev.events = EPOLLIN;
+  ev.data.ptr = &timerTag;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) == -1)
+    errExit("epoll_ctl(tfd)");
+
+  for (;;) {
+    ready = epoll_wait(epfd, evlist, MAX_EVENTS, -1);
+    if (ready == -1) {
+      if (errno == EINTR)
+	continue;
+      errExit("epoll_wait(2)");
+    }
+
+    for (j = 0; j < ready; j++) {
+      if (evlist[j].data.ptr == &listenTag) {
+	connAccept(epfd, ssck, 0, shm);
+	continue;
+      }
+      if (evlist[j].data.ptr == &localTag) {
+	connAccept(epfd, usck, 1, shm);
+	continue;
+      }
+      if (evlist[j].data.ptr == &timerTag) {
+	if (read(tfd, &expirations, sizeof expirations) == -1 && errno != EAGAIN)
+	  errMsg("read(tfd)");
+	timerDue = -1;
+	continue;
+      }
+
+      conn = evlist[j].data.ptr;
+
+      if (evlist[j].events & EPOLLOUT)
+	connFlush(conn);
+      if (evlist[j].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+	connRead(conn);
+
+      connProcess(conn);
+      connFlush(conn);
+      connUpdate(epfd, conn);
+    }
+
+    streamRun(epfd, tfd);
+  }
+}
+
+/* Run one reactor per listening socket in ssck[], n of them, each
+ * in thread pinned to its own core. Sockets are expected to share port
+ * by SO_REUSEPORT, kernel spreads connections over their accept
+ * queues. All reactors take turns on local listener usck, if any.
+ * Calling thread runs the first reactor, never returns */
+void epollServeCores(int *ssck, int n, int usck, acq_shared_s *shm)
+{
+  long ncpu;
+  int i, s;
+
+  ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  if (ncpu < 1)
+    ncpu = 1;
+
+  for (i = 0; i < n; i++) {
+    reactors[i].ssck = ssck[i];
+    reactors[i].usck = usck;
+    reactors[i].cpu = i % ncpu;
+    reactors[i].shm = shm;
+  }
+
+  for (i = 1; i < n; i++) {
+    s = pthread_create(&reactors[i].thr, NULL, reactorRun, &reactors[i]);
+    if (s != 0)
+      errExitEN(s, "pthread_create(reactor)");
+  }
+
+  reactorRun(&reactors[0]);
+}
+
+/***************** Local Functions Definitions ******************/
+
+static void *reactorRun(void *arg)
+{
+  reactor_s *r = arg;
+
+  reactorPin(r->cpu);
+  epollServe(r->ssck, r->usck, r->shm);
+
+  return NULL;
+}
+
+// Keep calling thread on one core, reactor works without it too
+static void reactorPin(int cpu)
+{
+  cpu_set_t set;
+  int s;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  s = pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+  if (s != 0) {
+    errno = s;
+    errMsg("pthread_setaffinity_np(cpu %d)", cpu);
+  }
+}
+
+/* Accept all pending connections of listener lsck, those of local
+ * one only after their peer passed credential check */
+static void connAccept(int epfd, int lsck, int local, acq_shared_s *shm)
+{
+  struct epoll_event ev;
+  conn_s *conn;
+  long long acceptNs;
+  int csck;
+
+  for (;;) {
+    csck = accept4(lsck, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (csck == -1) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	errMsg("accept4(2)");
+      return;
+    }
+    if (local && !localPeerOk(csck)) {
+      close(csck);
+      continue;
+    }
+
+    acceptNs = metNow();
+    conn = malloc(sizeof(conn_s));
+    if (conn == NULL) {
+      errMsg("malloc(conn_s)");
+      close(csck);
+      continue;
+    }
+    connInit(conn, csck, shm);
+    metObserve(MET_CONN_SPAWN, metNow() - acceptNs);
+
+    ev.events = conn->events = EPOLLIN;
+    ev.data.ptr = conn;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, csck, &ev) == -1) {
+      errMsg("epoll_ctl(csck)");
+      close(csck);
+      free(conn);
+    }
+  }
+}
+
+static void connClose(conn_s *conn)
+{
+  streamUnlist(conn);
+  connDone(conn);
+
+  // Closing fd removes it from epoll interest list too
+  if (close(conn->fd) == -1)
+    errMsg("close(csck)");
+
+  free(conn);
+}
+
+/* Close finished connection or bring its epoll events and streaming
+ * list membership in line with its state */
+static void connUpdate(int epfd, conn_s *conn)
+{
+  struct epoll_event ev;
+  uint32_t events = 0;
+
+  if (conn->closing && conn->outOff == conn->outLen) {
+    connClose(conn);
+    return;
+  }
+
+  if (cmdStreamDue(&conn->sess) < 0) {
+    streamUnlist(conn);
+  }
+  else if (!conn->listed) {
+    conn->prev = NULL;
+    conn->next = streamers;
+    if (streamers)
+      streamers->prev = conn;
+    streamers = conn;
+    conn->listed = 1;
+  }
+
+  /* Watch for input only while there is room for it and for output
+     only while something is pending */
+  if (!conn->closing && conn->inLen < sizeof conn->in)
+    events |= EPOLLIN;
+  if (conn->outOff < conn->outLen)
+    events |= EPOLLOUT;
+
+  if (events == conn->events)
+    return;
+
+  ev.events = conn->events = events;
+  ev.data.ptr = conn;
+  if (epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev) == -1)
+    errMsg("epoll_ctl(EPOLL_CTL_MOD)");
+}
+
+static void streamUnlist(conn_s *conn)
+{
+  if (!conn->listed)
+    return;
+
+  if (conn->prev)
+    conn->prev->next = conn->next;
+  else
+    streamers = conn->next;
+  if (conn->next)
+    conn->next->prev = conn->prev;
+
+  conn->listed = 0;
+}
+
+/* Push due samples to streaming connections and arm timer for the
+ * earliest next one */
+static void streamRun(int epfd, int tfd)
+{
+  struct itimerspec its = {};
+  conn_s *conn, *next;
+  long long due, earliest = -1;
+
+  for (conn = streamers; conn != NULL; conn = next) {
+    next = conn->next;
+
+    connStream(conn);
+    connFlush(conn);
+
+    due = cmdStreamDue(&conn->sess);
+    if (due >= 0 && (earliest < 0 || due < earliest))
+      earliest = due;
+
+    connUpdate(epfd, conn);
+  }
+
+  if (earliest == timerDue)
+    return;
+
+  // Zero it_value disarms the timer when nobody streams
+  if (earliest >= 0) {
+    its.it_value.tv_sec = earliest / 1000000000LL;
+    its.it_value.tv_nsec = earliest % 1000000000LL;
+  }
+
+  if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) == -1)
+    errMsg("timerfd_settime(2)");
+  timerDue = earliest;
+}
@@ -0,0 +1,24 @@
+/*****************************************************************
+ * Title    : INAepoll.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Event driven (epoll) server mode, single reactor or
+ *            one reactor thread per core
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INAEPOLL_H
+#define INAEPOLL_H
+
+/************************** Includes ****************************/
+#include "INAacq.h"
+
+/************ Global Symbolic Constant Definitions **************/
+
+#define EPOLL_MAX_REACTORS  64
+
+/************** Global Functions Prototype Declarations *********/
+
+void epollServe(int ssck, int usck, acq_shared_s *shm);
+void epollServeCores(int *ssck, int n, int usck, acq_shared_s *shm);
+
+#endif // INAEPOLL_H
@@ -0,0 +1,58 @@
+/*****************************************************************
+ * Title    : INAfmt.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Decimal formatting of fixed-point values for reply
+ *            text. Low-end boards emulate floating point, "%.2f"
+ *            of a double costs more there than the whole reply
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include "INAfmt.h"
+
+/************ Static global Variable Definitions ****************/
+
+static const uint64_t fmtPow10[] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+  1000000000
+};
+
+/**************** Global Functions Definitions ******************/
+
+/* Put val, which is in 10^-scale units, into buf as decimal number
+ * with "decimals" digits after point, like "%.*f" does. It rounds half
+ * away from zero and keeps sign of small negative values ("-0.00").
+ * Scale and decimals are 0..9, decimals not above scale. Buf must have
+ * FMT_FIXED_SIZE bytes, it is returned */
+char *fmtFixed(char *buf, int64_t val, int scale, int decimals)
+{
+  char digits[FMT_FIXED_SIZE];
+  uint64_t mag, div;
+  char *p = buf;
+  int n = 0;
+
+  if (val < 0) {
+    *p++ = '-';
+    mag = -(uint64_t)val;
+  }
+  else
+    mag = val;
+
+  div = fmtPow10[scale - decimals];
+  mag = mag / div + (2 * (mag % div) >= div);
+
+  // Digits come out from the lowest one, point after "decimals" of them
+  do {
+    if (n == decimals && n != 0)
+      digits[n++] = '.';
+    digits[n++] = '0' + mag % 10;
+    mag /= 10;
+  } while (mag != 0 || n <= decimals);
+
+  while (n > 0)
+    *p++ = digits[--n];
+  *p = '\0';
+
+  return buf;
+}
@@ -0,0 +1,24 @@
+/*****************************************************************
+ * Title    : INAfmt.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Decimal formatting of fixed-point values for reply
+ *            text, without floating point and printf()
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INAFMT_H
+#define INAFMT_H
+
+/************************** Includes ****************************/
+#include <stdint.h>
+
+/************ Global Symbolic Constant Definitions **************/
+
+// Room for any int64_t with sign, point and terminating NUL
+#define FMT_FIXED_SIZE  24
+
+/************** Global Functions Prototype Declarations *********/
+
+char *fmtFixed(char *buf, int64_t val, int scale, int decimals);
+
+#endif // INAFMT_H
@@ -0,0 +1,185 @@
+/*****************************************************************
+ * Title    : INAhist.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Multi-resolution history described in INAhist.h.
+ *            Every sample goes straight to bucket of each level,
+ *            query merges buckets of the coarsest level which fits
+ *            resolution, so week-long range costs a few thousand
+ *            buckets instead of every sample in it
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <string.h>
+#include <time.h>
+#include "INAhist.h"
+
+/**************** New Local Types Definitions *******************/
+
+// Level of the pyramid, its ring starts at bucket[first]
+typedef struct hist_level {
+  int64_t lenS;                 // Bucket length
+  int64_t buckets;
+  int first;
+} hist_level_s;
+
+/************ Static global Variable Definitions ****************/
+
+static const hist_level_s levels[HIST_LEVELS] = {
+  { HIST_SEC_S,  HIST_SEC_BUCKETS,  0 },
+  { HIST_MIN_S,  HIST_MIN_BUCKETS,  HIST_SEC_BUCKETS },
+  { HIST_HOUR_S, HIST_HOUR_BUCKETS, HIST_SEC_BUCKETS + HIST_MIN_BUCKETS }
+};
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static const hist_level_s *levelOf(int64_t resS);
+static void bucketRead(hist_bucket_s *b, hist_bucket_s *copy);
+
+/**************** Global Functions Definitions ******************/
+
+/* Add one sample taken at wallNs (CLOCK_REALTIME) to all levels, only
+ * acquisition worker of the channel calls it. Bucket left from a whole
+ * ring ago is started over */
+void histAdd(hist_chan_s *hc, int64_t wallNs, double volt, double curr,
+	     double power)
+{
+  int64_t wallS = wallNs / 1000000000LL;
+  const hist_level_s *lv;
+  hist_bucket_s *b;
+  int64_t id;
+  uint32_t lock;
+
+  for (lv = levels; lv < levels + HIST_LEVELS; lv++) {
+    id = wallS / lv->lenS;
+    b = &hc->bucket[lv->first + id % lv->buckets];
+
+    lock = __atomic_load_n(&b->lock, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->lock, lock + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (b->id != id) {
+      memset(&b->volt, 0, sizeof(stats_agg_s));
+      memset(&b->curr, 0, sizeof(stats_agg_s));
+      memset(&b->power, 0, sizeof(stats_agg_s));
+      b->id = id;
+    }
+    statsAggAdd(&b->volt, volt);
+    statsAggAdd(&b->curr, curr);
+    statsAggAdd(&b->power, power);
+
+    __atomic_store_n(&b->lock, lock + 2, __ATOMIC_RELEASE);
+  }
+}
+
+// Bucket length of level rows of resolution resS are made of
+int histLevelS(int64_t resS)
+{
+  return levelOf(resS)->lenS;
+}
+
+/* Resolution resS rounded up to whole buckets of the finest level
+ * still keeping fromS, so rows reaching back beyond its ring are not
+ * looked up in level which has nothing from then */
+int64_t histResolution(int64_t fromS, int64_t resS)
+{
+  int64_t nowS = time(NULL);
+  const hist_level_s *lv;
+
+  for (lv = levels; lv < levels + HIST_LEVELS - 1; lv++)
+    if ((nowS / lv->lenS - lv->buckets + 1) * lv->lenS <= fromS)
+      break;
+
+  return (resS + lv->lenS - 1) / lv->lenS * lv->lenS;
+}
+
+/* Rows of resolution resS (seconds) starting from fromS up to toS,
+ * wall time in seconds since Epoch. Rows are aligned to multiples of
+ * resS, those without samples are left out. Returns number of rows put
+ * in rows, at most max. When there are more, *nextS is where the
+ * following query starts, otherwise -1 */
+int histQuery(hist_chan_s *hc, int64_t fromS, int64_t toS, int64_t resS,
+	      hist_row_s *rows, int max, int64_t *nextS)
+{
+  const hist_level_s *lv = levelOf(resS);
+  int64_t nowId = time(NULL) / lv->lenS;
+  int64_t start, oldest, id, idLo, idHi;
+  hist_bucket_s copy;
+  hist_row_s *row;
+  int n = 0;
+
+  *nextS = -1;
+
+  // Nothing is kept from before the ring, nor from the future
+  start = fromS / resS * resS;
+  oldest = (nowId - lv->buckets + 1) * lv->lenS;
+  if (start < oldest)
+    start = oldest / resS * resS;
+  if (toS > (nowId + 1) * lv->lenS)
+    toS = (nowId + 1) * lv->lenS;
+
+  for (; start < toS; start += resS) {
+    if (n == max) {
+      *nextS = start;
+      break;
+    }
+
+    row = &rows[n];
+    memset(row, 0, sizeof(hist_row_s));
+    row->startS = start;
+
+    idLo = start / lv->lenS;
+    if (idLo < nowId - lv->buckets + 1)
+      idLo = nowId - lv->buckets + 1;
+    idHi = (start + resS) / lv->lenS;
+    if (idHi > nowId + 1)
+      idHi = nowId + 1;
+
+    for (id = idLo; id < idHi; id++) {
+      bucketRead(&hc->bucket[lv->first + id % lv->buckets], &copy);
+
+      // Bucket of other time, no sample came in this one
+      if (copy.id != id)
+	continue;
+
+      statsMerge(&row->volt, &copy.volt);
+      statsMerge(&row->curr, &copy.curr);
+      statsMerge(&row->power, &copy.power);
+    }
+
+    if (row->volt.n)
+      n++;
+  }
+
+  return n;
+}
+
+/***************** Local Functions Definitions ******************/
+
+/* Coarsest level whose bucket length divides resolution, rows are
+ * then made of whole buckets. Every resolution fits seconds, see
+ * histResolution() for resolutions reaching beyond them */
+static const hist_level_s *levelOf(int64_t resS)
+{
+  const hist_level_s *lv;
+
+  for (lv = levels + HIST_LEVELS - 1; lv > levels; lv--)
+    if (resS % lv->lenS == 0)
+      break;
+
+  return lv;
+}
+
+// Seqlock reader side, only the current bucket is being written
+static void bucketRead(hist_bucket_s *b, hist_bucket_s *copy)
+{
+  uint32_t lock1, lock2;
+
+  do {
+    lock1 = __atomic_load_n(&b->lock, __ATOMIC_ACQUIRE);
+    *copy = *b;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    lock2 = __atomic_load_n(&b->lock, __ATOMIC_RELAXED);
+  } while ((lock1 & 1) || lock1 != lock2);
+}
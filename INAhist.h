@@ -0,0 +1,66 @@
+/*****************************************************************
+ * Title    : INAhist.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Downsampled history of voltage, current and power,
+ *            pyramid of 1 s, 1 min and 1 h buckets updated by
+ *            acquisition worker at every conversion and queried
+ *            over long time ranges by "history" command
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INAHIST_H
+#define INAHIST_H
+
+/************************** Includes ****************************/
+#include <stdint.h>
+#include "INAstats.h"
+
+/************ Global Symbolic Constant Definitions **************/
+
+#define HIST_LEVELS  3
+
+// Buckets kept of every level, bucket of the level lasts HIST_*_S
+#define HIST_SEC_S          1
+#define HIST_SEC_BUCKETS    3600        // 1 hour
+#define HIST_MIN_S          60
+#define HIST_MIN_BUCKETS    10080       // 7 days
+#define HIST_HOUR_S         3600
+#define HIST_HOUR_BUCKETS   8784        // 366 days
+#define HIST_BUCKETS  (HIST_SEC_BUCKETS + HIST_MIN_BUCKETS + HIST_HOUR_BUCKETS)
+
+/**************** New Global Types Definitions ******************/
+
+/* Samples of one bucket. "lock" is seqlock sequence, odd while
+ * acquisition worker updates the bucket */
+typedef struct hist_bucket {
+  uint32_t lock;
+  int64_t id;                   // Wall time s / bucket length of level
+  stats_agg_s volt;
+  stats_agg_s curr;
+  stats_agg_s power;
+} hist_bucket_s;
+
+/* Rings of buckets of all levels of one channel, one after another,
+ * finest first. Bucket id is kept in id % buckets of its level */
+typedef struct hist_chan {
+  hist_bucket_s bucket[HIST_BUCKETS];
+} hist_chan_s;
+
+// One bucket of queried resolution, made of buckets of one level
+typedef struct hist_row {
+  int64_t startS;               // Wall time, seconds since Epoch
+  stats_agg_s volt;
+  stats_agg_s curr;
+  stats_agg_s power;
+} hist_row_s;
+
+/************** Global Functions Prototype Declarations *********/
+
+void histAdd(hist_chan_s *hc, int64_t wallNs, double volt, double curr,
+	     double power);
+int histLevelS(int64_t resS);
+int64_t histResolution(int64_t fromS, int64_t resS);
+int histQuery(hist_chan_s *hc, int64_t fromS, int64_t toS, int64_t resS,
+	      hist_row_s *rows, int max, int64_t *nextS);
+
+#endif // INAHIST_H
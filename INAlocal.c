@@ -0,0 +1,178 @@
+/*****************************************************************
+ * Title    : INAlocal.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Unix domain socket endpoint of INA219 server. Local
+ *            tools skip TCP/IP stack and reach the server even with
+ *            its network interface down. Access is limited by socket
+ *            file permissions and by SO_PEERCRED check of every peer
+ * Version  : 1.0
+ ****************************************************************/
+#define _GNU_SOURCE               // struct ucred
+
+/************************** Includes ****************************/
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <stddef.h>
+#include <poll.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/error_functions.h"
+#include "INAmetrics.h"
+#include "INAlocal.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+// Supplementary groups of peer looked through for the allowed one
+#define LOCAL_MAX_GROUPS  64
+
+// Socket file mode when group is given, others are kept out
+#define LOCAL_GROUP_MODE  0660
+
+/************ Static global Variable Definitions ****************/
+
+// Group allowed besides root and server's own user
+static gid_t peerGid = LOCAL_ANY_GID;
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static int peerInGroup(int csck, gid_t gid);
+
+/**************** Global Functions Definitions ******************/
+
+/* Create listening Unix stream socket at path, in abstract namespace
+ * when it starts by LOCAL_ABSTRACT. Stale socket file of previous run
+ * is replaced. Unless gid is LOCAL_ANY_GID, only root, server's user
+ * and members of gid are served, socket file is given to the group.
+ * Socket is nonblocking, see localAccept(). Returns -1 on error */
+int localListen(const char *path, int backlog, gid_t gid)
+{
+  struct sockaddr_un addr;
+  struct stat sb;
+  socklen_t len;
+  int usck, savedErrno;
+
+  if (strlen(path) >= sizeof addr.sun_path) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  len = sizeof addr;
+
+  if (path[0] == LOCAL_ABSTRACT) {
+    // Abstract name is exactly the bytes given, no terminating null
+    addr.sun_path[0] = '\0';
+    len = offsetof(struct sockaddr_un, sun_path) + strlen(path);
+  }
+  else if (lstat(path, &sb) == 0 && S_ISSOCK(sb.st_mode) && unlink(path) == -1)
+    return -1;
+
+  usck = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (usck == -1)
+    return -1;
+
+  if (bind(usck, (struct sockaddr *)&addr, len) == -1)
+    goto fail;
+
+  if (gid != LOCAL_ANY_GID && path[0] != LOCAL_ABSTRACT &&
+      (chown(path, -1, gid) == -1 || chmod(path, LOCAL_GROUP_MODE) == -1))
+    goto fail;
+
+  if (listen(usck, backlog) == -1)
+    goto fail;
+
+  peerGid = gid;
+  return usck;
+
+fail:
+  savedErrno = errno;
+  close(usck);
+  errno = savedErrno;
+  return -1;
+}
+
+/* Check credentials of peer connected to local socket csck. Returns 1
+ * if it may be served, 0 if not, refused peers are counted */
+int localPeerOk(int csck)
+{
+  struct ucred cred;
+  socklen_t len = sizeof cred;
+
+  if (peerGid == LOCAL_ANY_GID)
+    return 1;
+
+  if (getsockopt(csck, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 &&
+      (cred.uid == 0 || cred.uid == geteuid() || cred.gid == peerGid ||
+       peerInGroup(csck, peerGid)))
+    return 1;
+
+  metAdd(MET_CONN_REFUSED, 1);
+  return 0;
+}
+
+/* Accept next client of TCP listener ssck or of local listener usck,
+ * -1 stands for the missing one. With both, they must be nonblocking:
+ * connection announced by poll() may be taken by another process,
+ * then -1 is returned with errno EAGAIN. Refused local peer is closed
+ * and -1 returned with errno EACCES */
+int localAccept(int ssck, int usck)
+{
+  struct pollfd pfd[2];
+  int csck;
+
+  if (usck == -1)
+    return accept(ssck, NULL, NULL);
+
+  // poll() skips negative descriptor of missing TCP listener
+  pfd[0].fd = usck;
+  pfd[0].events = POLLIN;
+  pfd[1].fd = ssck;
+  pfd[1].events = POLLIN;
+  if (poll(pfd, 2, -1) == -1)
+    return -1;
+
+  // Local clients go first when both have connections waiting
+  if (!(pfd[0].revents & POLLIN)) {
+    if (ssck == -1) {
+      errno = EAGAIN;
+      return -1;
+    }
+    return accept(ssck, NULL, NULL);
+  }
+
+  csck = accept(usck, NULL, NULL);
+  if (csck != -1 && !localPeerOk(csck)) {
+    close(csck);
+    errno = EACCES;
+    return -1;
+  }
+
+  return csck;
+}
+
+/***************** Local Functions Definitions ******************/
+
+/* Is gid among supplementary groups peer of csck had when it
+ * connected. Kernel without SO_PEERGROUPS leaves primary group only */
+static int peerInGroup(int csck, gid_t gid)
+{
+#ifdef SO_PEERGROUPS
+  gid_t groups[LOCAL_MAX_GROUPS];
+  socklen_t len = sizeof groups;
+  int i, ngroups;
+
+  // Peer with too many groups gets ERANGE, it is not let in by them
+  if (getsockopt(csck, SOL_SOCKET, SO_PEERGROUPS, groups, &len) == -1)
+    return 0;
+
+  ngroups = len / sizeof(gid_t);
+  for (i = 0; i < ngroups; i++)
+    if (groups[i] == gid)
+      return 1;
+#endif // SO_PEERGROUPS
+
+  return 0;
+}
@@ -0,0 +1,30 @@
+/*****************************************************************
+ * Title    : INAlocal.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Unix domain socket endpoint for clients on the same
+ *            host, same protocol as TCP one, peers optionally
+ *            checked by their SO_PEERCRED credentials
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INALOCAL_H
+#define INALOCAL_H
+
+/************************** Includes ****************************/
+#include <sys/types.h>
+
+/************ Global Symbolic Constant Definitions **************/
+
+// Path starting by it names socket in abstract namespace
+#define LOCAL_ABSTRACT  '@'
+
+// No credential check of local peers
+#define LOCAL_ANY_GID   ((gid_t)-1)
+
+/************** Global Functions Prototype Declarations *********/
+
+int localListen(const char *path, int backlog, gid_t gid);
+int localPeerOk(int csck);
+int localAccept(int ssck, int usck);
+
+#endif // INALOCAL_H
@@ -0,0 +1,810 @@
+/*****************************************************************
+ * Title    : INAlog.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Sample log described in INAlog.h. Logger process
+ *            is one more consumer of sample rings, so sampling
+ *            never waits for the disk. Its main thread encodes
+ *            samples, writer thread writes them and commits all
+ *            what piled up meanwhile by one fdatasync()
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <sys/stat.h>
+#include <sys/prctl.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/error_functions.h"
+#include "INAring.h"
+#include "INAlog.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+#define LOG_PREFIX    "INA219"
+
+// New segment is started at the first key record past this size
+#define LOG_SEG_SIZE  (16 * 1024 * 1024)
+
+/* Encoded samples kept while writer is stalled, past it samples are
+ * dropped and show up as seq gap in the log */
+#define LOG_BUF_MAX   (16 * 1024 * 1024)
+
+// How often rings are polled, rings hold RING_SLOTS samples
+#define LOG_POLL_NS   20000000L
+
+// Longest possible record
+#define LOG_REC_MAX   80
+
+/**************** New Local Types Definitions *******************/
+
+// Key record at pos of buffer
+typedef struct log_key {
+  int64_t tsUs;
+  size_t pos;
+} log_key_s;
+
+// Encoded records on their way to disk
+typedef struct log_buf {
+  char *data;
+  size_t len, size;
+  log_key_s *key;
+  size_t nkey, keySize;
+} log_buf_s;
+
+// Logger state of one channel
+typedef struct log_chan {
+  int ch;
+  int ringOk;                   // Ring opened
+  ring_reader_s rd;
+  log_state_s st;               // Last encoded record
+  unsigned int nrec;            // Records since last key record
+  unsigned long dropped;        // Samples dropped, writer too slow
+  log_buf_s fill;               // Encoder appends here, under mutex
+  log_buf_s flush;              // Writer thread writes this one
+  int fd, idxfd;                // Current segment, -1 if none
+  uint64_t segSize;
+  int failed;                   // Write error already reported
+} log_chan_s;
+
+// Shared by encoder and writer thread
+typedef struct log_ctx {
+  const char *dir;
+  log_chan_s *chan;
+  int nchan;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int pending;                  // fill buffers have new records
+} log_ctx_s;
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static void logLoop(log_ctx_s *ctx);
+static void *logWriter(void *arg);
+static void logFlush(log_ctx_s *ctx, log_chan_s *c);
+static void logEncode(log_buf_s *b, log_state_s *st, const ring_sample_s *smp,
+		      int key);
+static void segOpen(log_ctx_s *ctx, log_chan_s *c, int64_t tsUs);
+static void segClose(log_chan_s *c);
+static void segWrite(log_chan_s *c, int fd, const char *buf, size_t len);
+static void bufReserve(log_buf_s *b, size_t len);
+static void putVar(log_buf_s *b, int64_t v);
+static int getVar(const unsigned char **p, const unsigned char *end, int64_t *v);
+static int recRead(log_reader_s *rd, ring_sample_s *smp);
+static void recFill(log_reader_s *rd);
+static int segRead(log_reader_s *rd, int i, int64_t fromUs);
+static off_t idxFind(const char *path, int64_t fromUs, off_t segSize);
+static int64_t segStartUs(const char *name);
+static int nameCmp(const void *a, const void *b);
+static void put16(char *p, uint16_t v);
+static void put32(char *p, uint32_t v);
+static void put64(char *p, uint64_t v);
+static uint32_t get32(const unsigned char *p);
+static uint64_t get64(const unsigned char *p);
+
+/**************** Global Functions Definitions ******************/
+
+/* Fork logger process, which logs samples of nchan channel rings
+ * named after ringName (see ringChanName()) into directory dir.
+ * Returns its pid */
+pid_t logStart(const char *dir, const char *ringName, int nchan)
+{
+  char name[NAME_MAX];
+  log_ctx_s ctx;
+  pthread_t thr;
+  pid_t pid;
+  int ch, s;
+
+  if (access(dir, W_OK | X_OK) == -1)
+    errExit("access(%s)", dir);
+
+  switch (pid = fork()) {
+  case -1:
+    errExit("fork(logger)");
+
+  case 0:
+    // Do not outlive the server
+    if (prctl(PR_SET_PDEATHSIG, SIGTERM) == -1)
+      errMsg("prctl(PR_SET_PDEATHSIG)");
+    if (getppid() == 1)
+      _exit(EXIT_FAILURE);
+    break;
+
+  default:
+    return pid;
+  }
+
+  memset(&ctx, 0, sizeof ctx);
+  ctx.dir = dir;
+  ctx.nchan = nchan;
+  ctx.chan = calloc(nchan, sizeof(log_chan_s));
+  if (ctx.chan == NULL)
+    errExit("calloc(log_chan_s)");
+
+  for (ch = 0; ch < nchan; ch++) {
+    ctx.chan[ch].ch = ch;
+    ctx.chan[ch].fd = ctx.chan[ch].idxfd = -1;
+    ringChanName(name, sizeof name, ringName, ch);
+    if (ringOpen(&ctx.chan[ch].rd, name) == -1)
+      errMsg("ringOpen(%s), channel %d is not logged", name, ch);
+    else
+      ctx.chan[ch].ringOk = 1;
+  }
+
+  pthread_mutex_init(&ctx.mutex, NULL);
+  pthread_cond_init(&ctx.cond, NULL);
+
+  s = pthread_create(&thr, NULL, logWriter, &ctx);
+  if (s != 0)
+    errExitEN(s, "pthread_create(logWriter)");
+
+  logLoop(&ctx);
+  _exit(EXIT_FAILURE);
+}
+
+/* Open log of channel ch in dir for reading. The first sample
+ * logNext() returns is the first one taken at fromNs or later,
+ * found by binary search of segment names and sparse index.
+ * Returns -1 on error */
+int logOpen(log_reader_s *rd, const char *dir, int ch, int64_t fromNs)
+{
+  char prefix[32];
+  struct dirent *de;
+  size_t prefixLen;
+  char **seg;
+  DIR *dp;
+  int lo, hi, mid, i;
+
+  memset(rd, 0, sizeof(log_reader_s));
+  rd->iseg = -1;
+  rd->fd = -1;
+
+  prefixLen = snprintf(prefix, sizeof prefix, LOG_PREFIX ".%d.", ch);
+
+  dp = opendir(dir);
+  if (dp == NULL)
+    return -1;
+  while ((de = readdir(dp)) != NULL) {
+    if (strncmp(de->d_name, prefix, prefixLen) != 0 ||
+	strlen(de->d_name) != prefixLen + 17 + 4 ||
+	strcmp(de->d_name + prefixLen + 17, ".log") != 0)
+      continue;
+
+    seg = realloc(rd->seg, (rd->nseg + 1) * sizeof(char *));
+    if (seg == NULL || (seg[rd->nseg] = strdup(de->d_name)) == NULL) {
+      if (seg != NULL)
+	rd->seg = seg;
+      closedir(dp);
+      logClose(rd);
+      errno = ENOMEM;
+      return -1;
+    }
+    rd->seg = seg;
+    rd->nseg++;
+  }
+  closedir(dp);
+
+  rd->dir = strdup(dir);
+  if (rd->nseg == 0)
+    return 0;
+  qsort(rd->seg, rd->nseg, sizeof(char *), nameCmp);
+
+  // Last segment which starts before fromNs
+  for (i = 0, lo = 0, hi = rd->nseg - 1; lo <= hi; ) {
+    mid = (lo + hi) / 2;
+    if (segStartUs(rd->seg[mid]) <= fromNs / 1000) {
+      i = mid;
+      lo = mid + 1;
+    }
+    else
+      hi = mid - 1;
+  }
+
+  // Damaged segment is skipped by logNext()
+  segRead(rd, i, fromNs / 1000);
+
+  // Key record is up to LOG_KEY_EVERY samples before fromNs
+  while (logNext(rd, &rd->peek) == 1)
+    if (rd->peek.tsNs >= fromNs) {
+      rd->peeked = 1;
+      break;
+    }
+
+  return 0;
+}
+
+/* Take next logged sample. Returns 1 if smp was filled, 0 at the end
+ * of log */
+int logNext(log_reader_s *rd, ring_sample_s *smp)
+{
+  if (rd->peeked) {
+    *smp = rd->peek;
+    rd->peeked = 0;
+    return 1;
+  }
+
+  while (rd->iseg >= 0) {
+    if (rd->fd != -1 && recRead(rd, smp))
+      return 1;
+
+    // End of segment, or partial record left by crash
+    if (rd->iseg + 1 >= rd->nseg || segRead(rd, rd->iseg + 1, -1) == -1) {
+      rd->iseg = -1;
+      break;
+    }
+  }
+
+  return 0;
+}
+
+/* Take up to max next logged samples into blk. Block ends before
+ * sample with other current LSB, that one starts the next block.
+ * Returns number of samples, 0 at the end of log */
+int logBlock(log_reader_s *rd, log_block_s *blk, int max)
+{
+  ring_sample_s smp;
+  int n;
+
+  for (n = 0; n < max && logNext(rd, &smp) == 1; n++) {
+    if (n == 0)
+      blk->currLsbA = smp.currLsbA;
+    else if (smp.currLsbA != blk->currLsbA) {
+      rd->peek = smp;
+      rd->peeked = 1;
+      break;
+    }
+
+    blk->tsNs[n] = smp.tsNs;
+    blk->err[n] = smp.err;
+    blk->shunt[n] = smp.shuntRegVal;
+    blk->bus[n] = smp.busRegVal;
+    blk->curr[n] = smp.currRegVal;
+    blk->power[n] = smp.powerRegVal;
+  }
+
+  return n;
+}
+
+void logClose(log_reader_s *rd)
+{
+  int i;
+
+  if (rd->fd != -1)
+    close(rd->fd);
+  for (i = 0; i < rd->nseg; i++)
+    free(rd->seg[i]);
+  free(rd->seg);
+  free(rd->dir);
+  memset(rd, 0, sizeof(log_reader_s));
+  rd->fd = -1;
+}
+
+/***************** Local Functions Definitions ******************/
+
+/* Main thread of logger process. Takes new samples of every ring,
+ * encodes them and wakes up writer thread */
+static void logLoop(log_ctx_s *ctx)
+{
+  struct timespec ts = { 0, LOG_POLL_NS };
+  ring_sample_s smp;
+  log_chan_s *c;
+  int ch, added;
+
+  for (;;) {
+    nanosleep(&ts, NULL);
+
+    added = 0;
+    pthread_mutex_lock(&ctx->mutex);
+
+    for (ch = 0; ch < ctx->nchan; ch++) {
+      c = &ctx->chan[ch];
+      if (!c->ringOk)
+	continue;
+
+      while (ringNext(&c->rd, &smp) == 1) {
+	if (c->fill.len >= LOG_BUF_MAX) {
+	  if (c->dropped++ == 0)
+	    fprintf(stderr, "log of channel %d stalled, dropping samples\n", ch);
+	  continue;
+	}
+	c->dropped = 0;
+
+	logEncode(&c->fill, &c->st, &smp, c->nrec == 0);
+	c->nrec = (c->nrec + 1) % LOG_KEY_EVERY;
+	added = 1;
+      }
+    }
+
+    if (added) {
+      ctx->pending = 1;
+      pthread_cond_signal(&ctx->cond);
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+  }
+}
+
+/* Writer thread. Takes over everything encoded so far, writes it and
+ * makes it durable. Records encoded during a slow fdatasync() wait in
+ * fill buffers and get committed together by the next one */
+static void *logWriter(void *arg)
+{
+  log_ctx_s *ctx = arg;
+  log_buf_s tmp;
+  log_chan_s *c;
+  int ch;
+
+  for (;;) {
+    pthread_mutex_lock(&ctx->mutex);
+    while (!ctx->pending)
+      pthread_cond_wait(&ctx->cond, &ctx->mutex);
+    ctx->pending = 0;
+
+    for (ch = 0; ch < ctx->nchan; ch++) {
+      c = &ctx->chan[ch];
+      tmp = c->fill;
+      c->fill = c->flush;
+      c->flush = tmp;
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+
+    for (ch = 0; ch < ctx->nchan; ch++) {
+      c = &ctx->chan[ch];
+      if (c->flush.len == 0)
+	continue;
+
+      logFlush(ctx, c);
+      if (c->fd != -1 && (fdatasync(c->fd) == -1 || fdatasync(c->idxfd) == -1))
+	errMsg("fdatasync(log channel %d)", ch);
+
+      c->flush.len = 0;
+      c->flush.nkey = 0;
+    }
+  }
+
+  return NULL;
+}
+
+/* Write flush buffer of channel into its segment and index entry of
+ * every key record. Segment is switched at key record, so every
+ * segment starts by one */
+static void logFlush(log_ctx_s *ctx, log_chan_s *c)
+{
+  log_buf_s *b = &c->flush;
+  char ent[LOG_IDX_SIZE];
+  size_t pos, end, k;
+  off_t off;
+
+  // Records before the first key one continue the open segment
+  end = b->nkey ? b->key[0].pos : b->len;
+  segWrite(c, c->fd, b->data, end);
+
+  for (k = 0; k < b->nkey; k++) {
+    pos = b->key[k].pos;
+    end = (k + 1 < b->nkey) ? b->key[k + 1].pos : b->len;
+
+    if (c->fd == -1 || c->segSize >= LOG_SEG_SIZE)
+      segOpen(ctx, c, b->key[k].tsUs);
+
+    // Index entry only after data it points to, see idxFind() too
+    off = c->segSize;
+    segWrite(c, c->fd, b->data + pos, end - pos);
+    put64(ent, b->key[k].tsUs);
+    put64(ent + 8, off);
+    segWrite(c, c->idxfd, ent, LOG_IDX_SIZE);
+  }
+}
+
+/* Append sample as record to b. Key record is encoded against zeroed
+ * state, so it does not depend on records before it */
+static void logEncode(log_buf_s *b, log_state_s *st, const ring_sample_s *smp,
+		      int key)
+{
+  int16_t reg[4] = { smp->shuntRegVal, smp->busRegVal,
+		     smp->currRegVal, smp->powerRegVal };
+  int64_t tsUs = smp->tsNs / 1000, dtUs;
+  unsigned char flags = 0, ext = 0;
+  uint32_t lsb;
+  int i;
+
+  bufReserve(b, LOG_REC_MAX);
+
+  if (key) {
+    memset(st, 0, sizeof(log_state_s));
+    ext |= LOG_X_KEY;
+    b->key[b->nkey].tsUs = tsUs;
+    b->key[b->nkey++].pos = b->len;
+  }
+
+  dtUs = tsUs - st->tsUs;
+  if (smp->seq != st->seq + 1)
+    flags |= LOG_F_SEQ;
+  if (dtUs != st->dtUs)
+    flags |= LOG_F_DT;
+  for (i = 0; i < 4; i++)
+    if (reg[i] != st->reg[i])
+      flags |= LOG_F_SHUNT << i;
+  if (smp->err)
+    ext |= LOG_X_ERR;
+  if (smp->currLsbA != st->currLsbA)
+    ext |= LOG_X_LSB;
+  if (ext)
+    flags |= LOG_F_EXT;
+
+  b->data[b->len++] = flags;
+  if (ext)
+    b->data[b->len++] = ext;
+  if (flags & LOG_F_SEQ)
+    putVar(b, (int32_t)(smp->seq - st->seq - 1));
+  if (flags & LOG_F_DT)
+    putVar(b, dtUs - st->dtUs);
+  for (i = 0; i < 4; i++)
+    if (flags & (LOG_F_SHUNT << i))
+      putVar(b, reg[i] - st->reg[i]);
+  if (ext & LOG_X_ERR)
+    b->data[b->len++] = smp->err;
+  if (ext & LOG_X_LSB) {
+    memcpy(&lsb, &smp->currLsbA, sizeof lsb);
+    put32(b->data + b->len, lsb);
+    b->len += 4;
+  }
+
+  st->seq = smp->seq;
+  st->tsUs = tsUs;
+  st->dtUs = key ? 0 : dtUs;
+  memcpy(st->reg, reg, sizeof reg);
+  st->currLsbA = smp->currLsbA;
+}
+
+// Close current segment and start new one named after tsUs
+static void segOpen(log_ctx_s *ctx, log_chan_s *c, int64_t tsUs)
+{
+  char path[PATH_MAX], hdr[LOG_HDR_SIZE];
+  int n;
+
+  segClose(c);
+
+  n = snprintf(path, sizeof path, "%s/" LOG_PREFIX ".%d.%017lld.log",
+	       ctx->dir, c->ch, (long long)tsUs);
+  c->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  strcpy(path + n - 4, ".idx");
+  c->idxfd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (c->fd == -1 || c->idxfd == -1) {
+    errMsg("open(%s)", path);
+    segClose(c);
+    return;
+  }
+
+  memset(hdr, 0, sizeof hdr);
+  put32(hdr, LOG_MAGIC);
+  put16(hdr + 4, LOG_VERSION);
+  put16(hdr + 6, c->ch);
+  c->segSize = 0;
+  segWrite(c, c->fd, hdr, sizeof hdr);
+}
+
+// Make current segment durable and close it
+static void segClose(log_chan_s *c)
+{
+  if (c->fd != -1) {
+    fdatasync(c->fd);
+    close(c->fd);
+  }
+  if (c->idxfd != -1) {
+    fdatasync(c->idxfd);
+    close(c->idxfd);
+  }
+  c->fd = c->idxfd = -1;
+}
+
+/* Write whole buf to segment or index file fd. After an error the
+ * segment is dropped, records after the failed one would not decode,
+ * next key record starts new segment */
+static void segWrite(log_chan_s *c, int fd, const char *buf, size_t len)
+{
+  ssize_t n;
+
+  if (fd == -1)
+    return;
+
+  while (len > 0) {
+    n = write(fd, buf, len);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n == -1) {
+      if (!c->failed)
+	errMsg("write(log channel %d)", c->ch);
+      c->failed = 1;
+      segClose(c);
+      return;
+    }
+    if (fd == c->fd)
+      c->segSize += n;
+    buf += n;
+    len -= n;
+  }
+  c->failed = 0;
+}
+
+// Make room for len more bytes and one more key in b
+static void bufReserve(log_buf_s *b, size_t len)
+{
+  if (b->len + len > b->size) {
+    b->size = b->size ? 2 * b->size : 64 * 1024;
+    b->data = realloc(b->data, b->size);
+    if (b->data == NULL)
+      errExit("realloc(log buffer)");
+  }
+
+  if (b->nkey == b->keySize) {
+    b->keySize = b->keySize ? 2 * b->keySize : 64;
+    b->key = realloc(b->key, b->keySize * sizeof(log_key_s));
+    if (b->key == NULL)
+      errExit("realloc(log keys)");
+  }
+}
+
+// Zigzag varint, small values of both signs take one byte
+static void putVar(log_buf_s *b, int64_t v)
+{
+  uint64_t u = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+
+  while (u >= 0x80) {
+    b->data[b->len++] = (u & 0x7f) | 0x80;
+    u >>= 7;
+  }
+  b->data[b->len++] = u;
+}
+
+/* Zigzag varint at *p, which is moved past it. Returns -1 if it does
+ * not end before end */
+static int getVar(const unsigned char **p, const unsigned char *end, int64_t *v)
+{
+  uint64_t u = 0;
+  int shift, c;
+
+  for (shift = 0; shift < 64; shift += 7) {
+    if (*p == end)
+      return -1;
+    c = *(*p)++;
+    u |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      *v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+/* Decode next record of current segment into smp, mirror of
+ * logEncode(). Record is decoded from read-ahead buffer, which holds
+ * a whole one unless segment ends sooner. Returns 0 at end of segment,
+ * state is left as it was when the record there is partial */
+static int recRead(log_reader_s *rd, ring_sample_s *smp)
+{
+  log_state_s *st = &rd->st, next;
+  const unsigned char *p, *end;
+  int flags, ext = 0, err = 0, i;
+  uint32_t u;
+  int64_t v;
+
+  recFill(rd);
+  p = rd->buf + rd->pos;
+  end = rd->buf + rd->len;
+
+  if (p == end)
+    return 0;
+  flags = *p++;
+  if (flags & LOG_F_EXT) {
+    if (p == end)
+      return 0;
+    ext = *p++;
+  }
+
+  next = *st;
+  if (ext & LOG_X_KEY)
+    memset(&next, 0, sizeof(log_state_s));
+
+  v = 0;
+  if ((flags & LOG_F_SEQ) && getVar(&p, end, &v) == -1)
+    return 0;
+  next.seq += 1 + v;
+
+  v = 0;
+  if ((flags & LOG_F_DT) && getVar(&p, end, &v) == -1)
+    return 0;
+  next.dtUs += v;
+  next.tsUs += next.dtUs;
+
+  for (i = 0; i < 4; i++)
+    if (flags & (LOG_F_SHUNT << i)) {
+      if (getVar(&p, end, &v) == -1)
+	return 0;
+      next.reg[i] += v;
+    }
+
+  if (ext & LOG_X_ERR) {
+    if (p == end)
+      return 0;
+    err = *p++;
+  }
+  if (ext & LOG_X_LSB) {
+    if (end - p < 4)
+      return 0;
+    u = get32(p);
+    memcpy(&next.currLsbA, &u, sizeof u);
+    p += 4;
+  }
+
+  rd->pos = p - rd->buf;
+  *st = next;
+
+  smp->seq = st->seq;
+  smp->err = err;
+  smp->tsNs = st->tsUs * 1000;
+  smp->shuntRegVal = st->reg[0];
+  smp->busRegVal = st->reg[1];
+  smp->currRegVal = st->reg[2];
+  smp->powerRegVal = st->reg[3];
+  smp->currLsbA = st->currLsbA;
+
+  if (ext & LOG_X_KEY)
+    st->dtUs = 0;
+
+  return 1;
+}
+
+/* Keep at least LOG_REC_MAX bytes of segment in read-ahead buffer,
+ * fewer only at its end */
+static void recFill(log_reader_s *rd)
+{
+  ssize_t n;
+
+  if (rd->len - rd->pos >= LOG_REC_MAX)
+    return;
+
+  memmove(rd->buf, rd->buf + rd->pos, rd->len - rd->pos);
+  rd->len -= rd->pos;
+  rd->pos = 0;
+
+  while (rd->len < sizeof rd->buf) {
+    n = read(rd->fd, rd->buf + rd->len, sizeof rd->buf - rd->len);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    rd->len += n;
+  }
+}
+
+/* Switch reader to segment i, positioned at key record found in
+ * index for fromUs, or at its first record if fromUs is -1 */
+static int segRead(log_reader_s *rd, int i, int64_t fromUs)
+{
+  char path[PATH_MAX];
+  unsigned char hdr[LOG_HDR_SIZE];
+  off_t off = LOG_HDR_SIZE;
+  struct stat sb;
+  int n;
+
+  if (rd->fd != -1)
+    close(rd->fd);
+  rd->iseg = i;
+  rd->pos = rd->len = 0;
+
+  n = snprintf(path, sizeof path, "%s/%s", rd->dir, rd->seg[i]);
+  rd->fd = open(path, O_RDONLY);
+  if (rd->fd == -1)
+    return -1;
+
+  if (pread(rd->fd, hdr, sizeof hdr, 0) != sizeof hdr ||
+      get32(hdr) != LOG_MAGIC || (hdr[4] | hdr[5] << 8) != LOG_VERSION) {
+    close(rd->fd);
+    rd->fd = -1;
+    return -1;
+  }
+
+  if (fromUs != -1 && fstat(rd->fd, &sb) == 0) {
+    strcpy(path + n - 4, ".idx");
+    off = idxFind(path, fromUs, sb.st_size);
+  }
+
+  return (lseek(rd->fd, off, SEEK_SET) == -1) ? -1 : 0;
+}
+
+/* Binary search of index file for the last key record taken at fromUs
+ * or before. Returns its offset, the first record if there is none.
+ * Index may reach to data not on disk after crash, entries pointing
+ * to segSize or past it are left out */
+static off_t idxFind(const char *path, int64_t fromUs, off_t segSize)
+{
+  unsigned char ent[LOG_IDX_SIZE];
+  off_t off = LOG_HDR_SIZE;
+  struct stat sb;
+  long lo, hi, mid;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd == -1)
+    return off;
+
+  if (fstat(fd, &sb) == 0)
+    for (lo = 0, hi = sb.st_size / LOG_IDX_SIZE - 1; lo <= hi; ) {
+      mid = (lo + hi) / 2;
+      if (pread(fd, ent, LOG_IDX_SIZE, (off_t)mid * LOG_IDX_SIZE) != LOG_IDX_SIZE)
+	break;
+      if ((int64_t)get64(ent) <= fromUs && (off_t)get64(ent + 8) < segSize) {
+	off = get64(ent + 8);
+	lo = mid + 1;
+      }
+      else
+	hi = mid - 1;
+    }
+
+  close(fd);
+  return off;
+}
+
+// Time of first sample of segment, taken from its name
+static int64_t segStartUs(const char *name)
+{
+  return strtoll(strchr(strchr(name, '.') + 1, '.') + 1, NULL, 10);
+}
+
+static int nameCmp(const void *a, const void *b)
+{
+  return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void put16(char *p, uint16_t v)
+{
+  p[0] = v & 0xff;
+  p[1] = v >> 8;
+}
+
+static void put32(char *p, uint32_t v)
+{
+  put16(p, v & 0xffff);
+  put16(p + 2, v >> 16);
+}
+
+static void put64(char *p, uint64_t v)
+{
+  put32(p, v & 0xffffffff);
+  put32(p + 4, v >> 32);
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get64(const unsigned char *p)
+{
+  return get32(p) | (uint64_t)get32(p + 4) << 32;
+}
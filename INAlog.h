@@ -0,0 +1,136 @@
+/*****************************************************************
+ * Title    : INAlog.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Append-only binary log of every acquired sample.
+ *            Logger process takes samples from shared memory rings
+ *            and persists them, readers seek in it by time
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INALOG_H
+#define INALOG_H
+
+/* Every channel has its own segment files in log directory, named
+ * after time of their first sample, so names sort by time:
+ *
+ *   INA219.<channel>.<first sample, us since Epoch, 17 digits>.log
+ *   INA219.<channel>.<first sample, us since Epoch, 17 digits>.idx
+ *
+ * Segment (.log), all fields little-endian:
+ *
+ *   offset size
+ *     0     4   magic     LOG_MAGIC
+ *     4     2   version   LOG_VERSION
+ *     6     2   channel
+ *     8     8   reserved
+ *    16   ...   records
+ *
+ * Record stores sample as difference to previous record:
+ *
+ *   size
+ *     1   flags     LOG_F_* bits, which fields follow
+ *     1   ext       LOG_X_* bits                      (LOG_F_EXT)
+ *     v   seq       seq gap minus one                 (LOG_F_SEQ)
+ *     v   dt        change of time step in us         (LOG_F_DT)
+ *     v   shunt     change of shunt voltage register  (LOG_F_SHUNT)
+ *     v   bus       change of bus voltage register    (LOG_F_BUS)
+ *     v   current   change of current register        (LOG_F_CURR)
+ *     v   power     change of power register          (LOG_F_POWER)
+ *     1   err       ACQ_ERR_* bits                    (LOG_X_ERR)
+ *     4   currLsb   current LSB in A, float            (LOG_X_LSB)
+ *
+ * "v" fields are zigzag varints, 7 bits a byte, low bits first. Field
+ * without its flag did not change, steady sample takes 1-5 bytes.
+ *
+ * Key record (LOG_X_KEY) is stored against all-zero previous record,
+ * so decoding may start there. Segment starts with one, then they
+ * come every LOG_KEY_EVERY records.
+ *
+ * Sparse index (.idx) has 16 byte entry for every key record:
+ *
+ *     0     8   time      sample time, us since Epoch
+ *     8     8   offset    record offset in segment
+ *
+ * Segment may end by partly written record after a crash, reader
+ * ignores it */
+
+/************************** Includes ****************************/
+#include <stdint.h>
+#include <sys/types.h>
+#include "INAring.h"
+
+/************ Global Symbolic Constant Definitions **************/
+
+#define LOG_MAGIC      0x4c414e49      // "INAL"
+#define LOG_VERSION    1
+#define LOG_HDR_SIZE   16
+#define LOG_IDX_SIZE   16
+#define LOG_KEY_EVERY  1024
+
+// Segment bytes reader decodes from memory at once
+#define LOG_READ_SIZE  16384
+
+// Record flags
+#define LOG_F_SEQ      0x01
+#define LOG_F_DT       0x02
+#define LOG_F_SHUNT    0x04
+#define LOG_F_BUS      0x08
+#define LOG_F_CURR     0x10
+#define LOG_F_POWER    0x20
+#define LOG_F_EXT      0x40
+
+// Bits of ext byte
+#define LOG_X_KEY      0x01
+#define LOG_X_ERR      0x02
+#define LOG_X_LSB      0x04
+
+/**************** New Global Types Definitions ******************/
+
+// Previous record, records are stored as difference to it
+typedef struct log_state {
+  uint32_t seq;
+  int64_t tsUs;
+  int64_t dtUs;
+  int16_t reg[4];               // shunt, bus, current, power
+  float currLsbA;
+} log_state_s;
+
+// Reader of one channel
+typedef struct log_reader {
+  char *dir;
+  char **seg;                   // Segment file names, sorted by time
+  int nseg;
+  int iseg;                     // Segment being read
+  int fd;
+  unsigned char buf[LOG_READ_SIZE];     // Read-ahead of segment
+  size_t pos, len;              // Next byte to decode, bytes in buf
+  log_state_s st;
+  int peeked;                   // First sample after seek is in peek
+  ring_sample_s peek;
+} log_reader_s;
+
+/* Samples of log in separate arrays per field, as bulk conversion
+ * (convBlock()) takes them. Arrays are given by caller, every sample
+ * of block was taken with the same current LSB */
+typedef struct log_block {
+  int64_t *tsNs;
+  int32_t *err;
+  int16_t *shunt;
+  int16_t *bus;
+  int16_t *curr;
+  int16_t *power;
+  float currLsbA;
+} log_block_s;
+
+/************** Global Functions Prototype Declarations *********/
+
+// Writer
+pid_t logStart(const char *dir, const char *ringName, int nchan);
+
+// Readers
+int logOpen(log_reader_s *rd, const char *dir, int ch, int64_t fromNs);
+int logNext(log_reader_s *rd, ring_sample_s *smp);
+int logBlock(log_reader_s *rd, log_block_s *blk, int max);
+void logClose(log_reader_s *rd);
+
+#endif // INALOG_H
@@ -0,0 +1,346 @@
+/*****************************************************************
+ * Title    : INAmcast.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Sample broadcast by UDP multicast, wire format is in
+ *            INAmcast.h. Publisher process is one more consumer of
+ *            sample rings, like logger, and sends what it finds in
+ *            them by one datagram per pass. Receiver side decodes
+ *            datagrams and keeps account of lost ones
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <sys/socket.h>
+#include <sys/prctl.h>
+#include <arpa/inet.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/error_functions.h"
+#include "../header/mkaddr.h"
+#include "INAacq.h"
+#include "INAring.h"
+#include "INAmcast.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+/* How often rings are polled. Short, live dashboards are the reason
+ * for multicast, yet samples of one pass share datagram */
+#define MCAST_POLL_NS   2000000L
+
+// Datagrams stay on local network
+#define MCAST_TTL       1
+
+/**************** New Local Types Definitions *******************/
+
+// Publisher state
+typedef struct mcast_pub {
+  int fd;
+  struct sockaddr_in dst;
+  uint32_t pubId;
+  uint32_t dgram;
+  int nchan;
+  ring_reader_s *rd;            // NULL hdr for channel without ring
+  char buf[MCAST_DGRAM_MAX];
+  int count;                    // Samples in buf
+  long long sentNs;             // CLOCK_MONOTONIC time of last datagram
+} mcast_pub_s;
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static void mcastLoop(mcast_pub_s *pub);
+static void mcastPut(mcast_pub_s *pub, int ch, const ring_sample_s *smp);
+static void mcastSend(mcast_pub_s *pub);
+static void put16(char *p, uint16_t v);
+static void put32(char *p, uint32_t v);
+static void put64(char *p, uint64_t v);
+static uint16_t get16(const unsigned char *p);
+static uint32_t get32(const unsigned char *p);
+static uint64_t get64(const unsigned char *p);
+
+/**************** Global Functions Definitions ******************/
+
+/* Fork publisher process, which sends samples of nchan channel rings
+ * named after ringName (see ringChanName()) to group:port out of
+ * interface ifName. Returns its pid */
+pid_t mcastStart(struct in_addr group, int port, char *ifName,
+		 const char *ringName, int nchan)
+{
+  char name[NAME_MAX];
+  unsigned char ttl = MCAST_TTL;
+  struct sockaddr_in ifAddr;
+  mcast_pub_s *pub;
+  pid_t pid;
+  int ch;
+
+  switch (pid = fork()) {
+  case -1:
+    errExit("fork(publisher)");
+
+  case 0:
+    // Do not outlive the server
+    if (prctl(PR_SET_PDEATHSIG, SIGTERM) == -1)
+      errMsg("prctl(PR_SET_PDEATHSIG)");
+    if (getppid() == 1)
+      _exit(EXIT_FAILURE);
+    break;
+
+  default:
+    return pid;
+  }
+
+  pub = calloc(1, sizeof(mcast_pub_s));
+  if (pub == NULL)
+    errExit("calloc(mcast_pub_s)");
+  pub->rd = calloc(nchan, sizeof(ring_reader_s));
+  if (pub->rd == NULL)
+    errExit("calloc(ring_reader_s)");
+  pub->nchan = nchan;
+
+  pub->fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (pub->fd == -1)
+    errExit("socket(SOCK_DGRAM)");
+  if (getIfaddr(pub->fd, (struct sockaddr *)&ifAddr, ifName) == -1)
+    errExit("getIfaddr(%s)", ifName);
+  if (setsockopt(pub->fd, IPPROTO_IP, IP_MULTICAST_IF, &ifAddr.sin_addr,
+		 sizeof ifAddr.sin_addr) == -1)
+    errExit("setsockopt(IP_MULTICAST_IF)");
+  if (setsockopt(pub->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof ttl) == -1)
+    errMsg("setsockopt(IP_MULTICAST_TTL)");
+
+  pub->dst.sin_family = AF_INET;
+  pub->dst.sin_addr = group;
+  pub->dst.sin_port = htons(port);
+
+  // Receivers tell restarted publisher by its new id
+  pub->pubId = (uint32_t)acqNowNs() ^ (uint32_t)getpid() << 16;
+
+  // ringOpen() starts at the newest sample, older ones are in the log
+  for (ch = 0; ch < nchan; ch++) {
+    ringChanName(name, sizeof name, ringName, ch);
+    if (ringOpen(&pub->rd[ch], name) == -1) {
+      errMsg("ringOpen(%s), channel %d is not published", name, ch);
+      pub->rd[ch].hdr = NULL;
+    }
+  }
+
+  mcastLoop(pub);
+  _exit(EXIT_FAILURE);
+}
+
+/* Join group on port at interface with address ifAddr (INADDR_ANY
+ * lets kernel choose it). Returns -1 on error */
+int mcastJoin(mcast_rx_s *rx, struct in_addr group, int port,
+	      struct in_addr ifAddr)
+{
+  struct sockaddr_in addr;
+  struct ip_mreq mreq;
+  int optval = 1;
+
+  memset(rx, 0, sizeof(mcast_rx_s));
+
+  rx->fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (rx->fd == -1)
+    return -1;
+
+  // More receivers may run on one host
+  if (setsockopt(rx->fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof optval) == -1)
+    goto fail;
+
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_addr = group;
+  addr.sin_port = htons(port);
+  if (bind(rx->fd, (struct sockaddr *)&addr, sizeof addr) == -1)
+    goto fail;
+
+  mreq.imr_multiaddr = group;
+  mreq.imr_interface = ifAddr;
+  if (setsockopt(rx->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof mreq) == -1)
+    goto fail;
+
+  return 0;
+
+fail:
+  close(rx->fd);
+  rx->fd = -1;
+  return -1;
+}
+
+/* Receive one datagram and put up to max of its samples in smp.
+ * Lost datagrams and samples are counted in rx, channels which missed
+ * samples get their bit set in rx->resync, caller clears it once it
+ * fetched them. Returns number of samples, 0 for heartbeat, foreign,
+ * duplicate or late datagram, -1 on error */
+int mcastRecv(mcast_rx_s *rx, mcast_sample_s *smp, int max)
+{
+  unsigned char buf[MCAST_DGRAM_MAX];
+  const unsigned char *p;
+  uint32_t pubId, dgram, seq;
+  ssize_t len;
+  int count, n = 0, i, ch;
+
+  len = recv(rx->fd, buf, sizeof buf, 0);
+  if (len == -1)
+    return -1;
+
+  if (len < MCAST_HDR_SIZE || get32(buf) != MCAST_MAGIC ||
+      get16(buf + 4) != MCAST_VERSION)
+    return 0;
+  count = get16(buf + 6);
+  if (len < MCAST_HDR_SIZE + count * MCAST_REC_SIZE)
+    return 0;
+
+  pubId = get32(buf + 8);
+  dgram = get32(buf + 12);
+
+  // Sequence numbers of new publisher have nothing to do with old ones
+  if (!rx->synced || pubId != rx->pubId) {
+    memset(rx->nextSeq, 0, sizeof rx->nextSeq);
+    rx->pubId = pubId;
+    rx->synced = 1;
+  }
+  else if ((int32_t)(dgram - rx->nextDgram) < 0) {
+    return 0;
+  }
+  else {
+    rx->lostDgrams += dgram - rx->nextDgram;
+  }
+  rx->nextDgram = dgram + 1;
+
+  for (i = 0; i < count; i++) {
+    p = buf + MCAST_HDR_SIZE + i * MCAST_REC_SIZE;
+    ch = p[24];
+    if (ch >= ACQ_MAX_CHAN)
+      continue;
+
+    seq = get32(p);
+    if (rx->nextSeq[ch] != 0 && (int32_t)(seq - rx->nextSeq[ch]) > 0) {
+      rx->lostSamples += seq - rx->nextSeq[ch];
+      if (!(rx->resync & (1U << ch)))
+	rx->gapNs[ch] = rx->lastNs[ch];
+      rx->resync |= 1U << ch;
+    }
+    rx->nextSeq[ch] = seq + 1;
+    rx->lastNs[ch] = get64(p + 4);
+
+    if (n == max)
+      continue;
+    smp[n].ch = ch;
+    smp[n].s.seq = seq;
+    smp[n].s.tsNs = rx->lastNs[ch];
+    smp[n].s.shuntRegVal = get16(p + 12);
+    smp[n].s.busRegVal = get16(p + 14);
+    smp[n].s.currRegVal = get16(p + 16);
+    smp[n].s.powerRegVal = get16(p + 18);
+    seq = get32(p + 20);
+    memcpy(&smp[n].s.currLsbA, &seq, sizeof smp[n].s.currLsbA);
+    smp[n].s.err = p[25];
+    n++;
+  }
+
+  return n;
+}
+
+/***************** Local Functions Definitions ******************/
+
+/* Main loop of publisher. Takes new samples of every ring, sends
+ * them when datagram is full and at the end of each pass */
+static void mcastLoop(mcast_pub_s *pub)
+{
+  struct timespec ts = { 0, MCAST_POLL_NS };
+  ring_sample_s smp;
+  int ch;
+
+  pub->sentNs = acqNowNs();
+
+  for (;;) {
+    nanosleep(&ts, NULL);
+
+    for (ch = 0; ch < pub->nchan; ch++) {
+      if (pub->rd[ch].hdr == NULL)
+	continue;
+      while (ringNext(&pub->rd[ch], &smp) == 1)
+	mcastPut(pub, ch, &smp);
+    }
+
+    if (pub->count > 0 || acqNowNs() - pub->sentNs >= MCAST_HEARTBEAT_NS)
+      mcastSend(pub);
+  }
+}
+
+static void mcastPut(mcast_pub_s *pub, int ch, const ring_sample_s *smp)
+{
+  char *p = pub->buf + MCAST_HDR_SIZE + pub->count * MCAST_REC_SIZE;
+  uint32_t lsb;
+
+  memcpy(&lsb, &smp->currLsbA, sizeof lsb);
+  put32(p, smp->seq);
+  put64(p + 4, (uint64_t)smp->tsNs);
+  put16(p + 12, (uint16_t)smp->shuntRegVal);
+  put16(p + 14, (uint16_t)smp->busRegVal);
+  put16(p + 16, (uint16_t)smp->currRegVal);
+  put16(p + 18, (uint16_t)smp->powerRegVal);
+  put32(p + 20, lsb);
+  p[24] = ch;
+  p[25] = smp->err;
+  p[26] = p[27] = 0;
+
+  if (++pub->count == MCAST_MAX_SAMPLES)
+    mcastSend(pub);
+}
+
+/* Send datagram with samples collected so far. Datagram which could
+ * not be sent still takes its number, receivers see it lost */
+static void mcastSend(mcast_pub_s *pub)
+{
+  size_t len = MCAST_HDR_SIZE + pub->count * MCAST_REC_SIZE;
+
+  put32(pub->buf, MCAST_MAGIC);
+  put16(pub->buf + 4, MCAST_VERSION);
+  put16(pub->buf + 6, pub->count);
+  put32(pub->buf + 8, pub->pubId);
+  put32(pub->buf + 12, pub->dgram++);
+
+  if (sendto(pub->fd, pub->buf, len, 0, (struct sockaddr *)&pub->dst,
+	     sizeof pub->dst) == -1 && errno != ENOBUFS && errno != EAGAIN)
+    errMsg("sendto(multicast)");
+
+  pub->count = 0;
+  pub->sentNs = acqNowNs();
+}
+
+static void put16(char *p, uint16_t v)
+{
+  p[0] = v & 0xff;
+  p[1] = v >> 8;
+}
+
+static void put32(char *p, uint32_t v)
+{
+  put16(p, v & 0xffff);
+  put16(p + 2, v >> 16);
+}
+
+static void put64(char *p, uint64_t v)
+{
+  put32(p, v & 0xffffffff);
+  put32(p + 4, v >> 32);
+}
+
+static uint16_t get16(const unsigned char *p)
+{
+  return p[0] | p[1] << 8;
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get64(const unsigned char *p)
+{
+  return get32(p) | (uint64_t)get32(p + 4) << 32;
+}
@@ -0,0 +1,98 @@
+/*****************************************************************
+ * Title    : INAmcast.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Sample broadcast by UDP multicast. Publisher process
+ *            sends every acquired sample to multicast group, any
+ *            number of receivers join it and detect lost ones
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INAMCAST_H
+#define INAMCAST_H
+
+/* Datagram, all fields little-endian:
+ *
+ *   offset size
+ *     0     4   magic     MCAST_MAGIC
+ *     4     2   version   MCAST_VERSION
+ *     6     2   count     samples in datagram, 0 for heartbeat
+ *     8     4   pubId     publisher instance, new one after restart
+ *    12     4   dgram     datagram sequence number, +1 every datagram
+ *    16   ...   count samples, MCAST_REC_SIZE bytes each
+ *
+ * Sample:
+ *
+ *     0     4   seq       sample sequence number of its channel
+ *     4     8   time      sample time, ns since Epoch (UTC)
+ *    12     2   shunt     shunt voltage register, signed
+ *    14     2   bus       bus voltage register (CNVR, OVF in bits 1, 0)
+ *    16     2   current   current register, signed
+ *    18     2   power     power register
+ *    20     4   currLsb   current LSB in A, float
+ *    24     1   channel   INA219 device the sample is of
+ *    25     1   err       ACQ_ERR_* bits of failed register reads
+ *    26     2   reserved  zero
+ *
+ * Samples are sent in batches as acquired, heartbeat goes out when
+ * there was nothing to send for MCAST_HEARTBEAT_NS, so lost tail of
+ * stream is noticed too.
+ *
+ * Receiver finds lost datagrams by gaps in dgram and samples the
+ * publisher itself could not keep up with by gaps in seq of channel.
+ * Missed samples can be fetched over TCP when server keeps sample
+ * log (-l), by "log <channel> <time of last sample before gap>" */
+
+/************************** Includes ****************************/
+#include <stdint.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include "INAacq.h"
+#include "INAring.h"
+
+/************ Global Symbolic Constant Definitions **************/
+
+#define MCAST_MAGIC         0x4d414e49     // "INAM"
+#define MCAST_VERSION       1
+#define MCAST_HDR_SIZE      16
+#define MCAST_REC_SIZE      28
+
+// Datagram stays below Ethernet MTU
+#define MCAST_MAX_SAMPLES   48
+#define MCAST_DGRAM_MAX     (MCAST_HDR_SIZE + MCAST_MAX_SAMPLES * MCAST_REC_SIZE)
+
+#define MCAST_HEARTBEAT_NS  1000000000LL
+
+/**************** New Global Types Definitions ******************/
+
+// Received sample
+typedef struct mcast_sample {
+  int ch;
+  ring_sample_s s;              // tsNs is wall time
+} mcast_sample_s;
+
+// Receiver state
+typedef struct mcast_rx {
+  int fd;
+  int synced;                   // pubId and nextDgram are known
+  uint32_t pubId;
+  uint32_t nextDgram;
+  uint32_t nextSeq[ACQ_MAX_CHAN];       // 0 until channel is seen
+  int64_t lastNs[ACQ_MAX_CHAN];         // Time of last received sample
+  uint32_t resync;              // Channels with missed samples, bit each
+  int64_t gapNs[ACQ_MAX_CHAN];  // Last sample before the first gap
+  unsigned long lostDgrams;
+  unsigned long lostSamples;
+} mcast_rx_s;
+
+/************** Global Functions Prototype Declarations *********/
+
+// Publisher
+pid_t mcastStart(struct in_addr group, int port, char *ifName,
+		 const char *ringName, int nchan);
+
+// Receiver
+int mcastJoin(mcast_rx_s *rx, struct in_addr group, int port,
+	      struct in_addr ifAddr);
+int mcastRecv(mcast_rx_s *rx, mcast_sample_s *smp, int max);
+
+#endif // INAMCAST_H
@@ -0,0 +1,367 @@
+/*****************************************************************
+ * Title    : INAmetrics.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Metrics of INA219 server described in INAmetrics.h,
+ *            their JSON and Prometheus text form and listener
+ *            process serving the latter over HTTP
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <signal.h>
+#include <time.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/error_functions.h"
+#include "INAacq.h"
+#include "INAmetrics.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+// Client of Prometheus listener which does not read or talk is dropped
+#define MET_SOCK_TIMEOUT_S  2
+
+/**************** New Local Types Definitions *******************/
+
+// Prometheus name and label of histogram, JSON uses the label
+typedef struct met_name {
+  const char *metric;
+  const char *label;
+  const char *value;
+} met_name_s;
+
+/************ Static global Variable Definitions ****************/
+
+// NULL until metCreate(), observations are dropped then
+static met_shared_s *met;
+
+static const met_name_s histName[MET_HISTS] = {
+  { "ina219_command_seconds", "command", "voltage" },
+  { "ina219_command_seconds", "command", "current" },
+  { "ina219_command_seconds", "command", "log" },
+  { "ina219_command_seconds", "command", "stats" },
+  { "ina219_command_seconds", "command", "energy" },
+  { "ina219_command_seconds", "command", "stream" },
+  { "ina219_command_seconds", "command", "proto" },
+  { "ina219_command_seconds", "command", "config" },
+  { "ina219_command_seconds", "command", "stop" },
+  { "ina219_command_seconds", "command", "exit" },
+  { "ina219_command_seconds", "command", "metrics" },
+  { "ina219_command_seconds", "command", "batch" },
+  { "ina219_command_seconds", "command", "trigger" },
+  { "ina219_command_seconds", "command", "history" },
+  { "ina219_command_seconds", "command", "report" },
+  { "ina219_command_seconds", "command", "unknown" },
+  { "ina219_i2c_seconds", "op", "burst_read" },
+  { "ina219_i2c_seconds", "op", "read" },
+  { "ina219_i2c_seconds", "op", "write" },
+  { "ina219_conn_spawn_seconds", NULL, "spawn" },
+  { "ina219_conn_lifetime_seconds", NULL, "lifetime" },
+  { "ina219_socket_write_seconds", NULL, "socket_write" },
+  { "ina219_timestamp_format_seconds", NULL, "ts_format" },
+};
+
+static const char *counterName[MET_COUNTERS] = {
+  "ina219_connections_accepted_total",
+  "ina219_connections_closed_total",
+  "ina219_received_bytes_total",
+  "ina219_sent_bytes_total",
+  "ina219_socket_write_partial_total",
+  "ina219_connections_refused_total",
+};
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static uint64_t load(const uint64_t *p);
+static double histPercentileUs(const met_hist_s *h, double pct);
+static void metServe(int ssck, acq_shared_s *shm);
+
+/**************** Global Functions Definitions ******************/
+
+/* Create shared metrics before any fork(), so every process of
+ * server adds to the same ones */
+void metCreate(void)
+{
+  met = mmap(NULL, sizeof(met_shared_s), PROT_READ | PROT_WRITE,
+	     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (met == MAP_FAILED)
+    errExit("mmap(met_shared_s)");
+
+  met->startNs = metNow();
+}
+
+// Time base of observations, CLOCK_MONOTONIC ns
+long long metNow(void)
+{
+  return acqNowNs();
+}
+
+void metObserve(int hist, long long ns)
+{
+  met_hist_s *h;
+  uint64_t us;
+  int k;
+
+  if (met == NULL)
+    return;
+  if (ns < 0)
+    ns = 0;
+
+  // Smallest k with us <= 2^k
+  us = (ns + 999) / 1000;
+  k = (us <= 1) ? 0 : 64 - __builtin_clzll(us - 1);
+  if (k > MET_BUCKETS - 1)
+    k = MET_BUCKETS - 1;
+
+  h = &met->hist[hist];
+  __atomic_fetch_add(&h->bucket[k], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&h->sumNs, ns, __ATOMIC_RELAXED);
+}
+
+void metAdd(int counter, uint64_t n)
+{
+  if (met != NULL)
+    __atomic_fetch_add(&met->counter[counter], n, __ATOMIC_RELAXED);
+}
+
+/* Summary of metrics for "metrics" command, histograms which have
+ * any observation with mean and bucket bounds of median and p99.
+ * Scheduler counters are summed over channels */
+void metJson(acq_shared_s *shm, char *buf, size_t size)
+{
+  const met_hist_s *h;
+  uint64_t samples = 0, stale = 0, misses = 0, count;
+  int64_t latSum = 0, latMax = 0, v;
+  size_t len;
+  int i, ch;
+
+  if (met == NULL) {
+    snprintf(buf, size, "{ \"WARN\":\"Metrics are off\" }\n");
+    return;
+  }
+
+  for (ch = 0; ch < shm->nchan; ch++) {
+    samples += __atomic_load_n(&shm->chan[ch].sched.samples, __ATOMIC_RELAXED);
+    stale += __atomic_load_n(&shm->chan[ch].sched.stale, __ATOMIC_RELAXED);
+    misses += __atomic_load_n(&shm->chan[ch].sched.cnvrMisses, __ATOMIC_RELAXED);
+    latSum += __atomic_load_n(&shm->chan[ch].sched.latSumNs, __ATOMIC_RELAXED);
+    v = __atomic_load_n(&shm->chan[ch].sched.latMaxNs, __ATOMIC_RELAXED);
+    if (v > latMax)
+      latMax = v;
+  }
+
+  len = snprintf(buf, size, "{ \"metrics\":{ \"uptime_s\":%.0f, "
+		 "\"conns\":{ \"accepted\":%llu, \"closed\":%llu, \"refused\":%llu }, "
+		 "\"bytes\":{ \"in\":%llu, \"out\":%llu }, \"partial_writes\":%llu, "
+		 "\"sched\":{ \"samples\":%llu, \"stale\":%llu, \"cnvr_retries\":%llu, "
+		 "\"lat_avg_us\":%.1f, \"lat_max_us\":%.1f }, \"latency_us\":{",
+		 (metNow() - met->startNs) / 1e9,
+		 (unsigned long long)load(&met->counter[MET_CONN_ACCEPTED]),
+		 (unsigned long long)load(&met->counter[MET_CONN_CLOSED]),
+		 (unsigned long long)load(&met->counter[MET_CONN_REFUSED]),
+		 (unsigned long long)load(&met->counter[MET_BYTES_IN]),
+		 (unsigned long long)load(&met->counter[MET_BYTES_OUT]),
+		 (unsigned long long)load(&met->counter[MET_WRITE_AGAIN]),
+		 (unsigned long long)samples, (unsigned long long)stale,
+		 (unsigned long long)misses,
+		 samples ? latSum / 1e3 / samples : 0.0, latMax / 1e3);
+
+  for (i = 0; i < MET_HISTS && len < size; i++) {
+    h = &met->hist[i];
+    count = load(&h->count);
+    if (count == 0)
+      continue;
+    len += snprintf(buf + len, size - len, "%s \"%s\":{ \"n\":%llu, \"avg\":%.1f, "
+		    "\"p50\":%g, \"p99\":%g }", (buf[len - 1] == '{') ? "" : ",",
+		    histName[i].value, (unsigned long long)count,
+		    load(&h->sumNs) / 1e3 / count, histPercentileUs(h, 50),
+		    histPercentileUs(h, 99));
+  }
+
+  if (len < size)
+    snprintf(buf + len, size - len, " } } }\n");
+}
+
+/* All metrics in Prometheus text exposition format, histograms with
+ * cumulative buckets, scheduler counters per channel */
+void metProm(acq_shared_s *shm, FILE *fp)
+{
+  const met_hist_s *h;
+  const char *prev = "";
+  uint64_t cum;
+  char label[64];
+  int i, k, ch;
+
+  fprintf(fp, "# TYPE ina219_uptime_seconds gauge\nina219_uptime_seconds %.3f\n",
+	  (metNow() - met->startNs) / 1e9);
+
+  for (i = 0; i < MET_COUNTERS; i++)
+    fprintf(fp, "# TYPE %s counter\n%s %llu\n", counterName[i], counterName[i],
+	    (unsigned long long)load(&met->counter[i]));
+
+  for (i = 0; i < MET_HISTS; i++) {
+    h = &met->hist[i];
+    if (strcmp(prev, histName[i].metric))
+      fprintf(fp, "# TYPE %s histogram\n", histName[i].metric);
+    prev = histName[i].metric;
+
+    if (histName[i].label != NULL)
+      snprintf(label, sizeof label, "%s=\"%s\",", histName[i].label, histName[i].value);
+    else
+      label[0] = '\0';
+
+    for (k = 0, cum = 0; k < MET_BUCKETS - 1; k++) {
+      cum += load(&h->bucket[k]);
+      fprintf(fp, "%s_bucket{%sle=\"%.9g\"} %llu\n", histName[i].metric, label,
+	      (double)(1LL << k) / 1e6, (unsigned long long)cum);
+    }
+    fprintf(fp, "%s_bucket{%sle=\"+Inf\"} %llu\n", histName[i].metric, label,
+	    (unsigned long long)load(&h->count));
+
+    // Label set without the trailing comma
+    if (histName[i].label != NULL)
+      snprintf(label, sizeof label, "{%s=\"%s\"}", histName[i].label, histName[i].value);
+    fprintf(fp, "%s_sum%s %.9f\n%s_count%s %llu\n", histName[i].metric, label,
+	    load(&h->sumNs) / 1e9, histName[i].metric, label,
+	    (unsigned long long)load(&h->count));
+  }
+
+  fprintf(fp, "# TYPE ina219_samples_total counter\n");
+  for (ch = 0; ch < shm->nchan; ch++)
+    fprintf(fp, "ina219_samples_total{channel=\"%d\"} %u\n", ch,
+	    __atomic_load_n(&shm->chan[ch].sched.samples, __ATOMIC_RELAXED));
+  fprintf(fp, "# TYPE ina219_stale_samples_total counter\n");
+  for (ch = 0; ch < shm->nchan; ch++)
+    fprintf(fp, "ina219_stale_samples_total{channel=\"%d\"} %u\n", ch,
+	    __atomic_load_n(&shm->chan[ch].sched.stale, __ATOMIC_RELAXED));
+  fprintf(fp, "# TYPE ina219_cnvr_retries_total counter\n");
+  for (ch = 0; ch < shm->nchan; ch++)
+    fprintf(fp, "ina219_cnvr_retries_total{channel=\"%d\"} %u\n", ch,
+	    __atomic_load_n(&shm->chan[ch].sched.cnvrMisses, __ATOMIC_RELAXED));
+  fprintf(fp, "# TYPE ina219_sched_latency_seconds_total counter\n");
+  for (ch = 0; ch < shm->nchan; ch++)
+    fprintf(fp, "ina219_sched_latency_seconds_total{channel=\"%d\"} %.9f\n", ch,
+	    __atomic_load_n(&shm->chan[ch].sched.latSumNs, __ATOMIC_RELAXED) / 1e9);
+  fprintf(fp, "# TYPE ina219_sched_latency_max_seconds gauge\n");
+  for (ch = 0; ch < shm->nchan; ch++)
+    fprintf(fp, "ina219_sched_latency_max_seconds{channel=\"%d\"} %.9f\n", ch,
+	    __atomic_load_n(&shm->chan[ch].sched.latMaxNs, __ATOMIC_RELAXED) / 1e9);
+  fprintf(fp, "# TYPE ina219_period_seconds gauge\n");
+  for (ch = 0; ch < shm->nchan; ch++)
+    fprintf(fp, "ina219_period_seconds{channel=\"%d\"} %g\n", ch,
+	    shm->chan[ch].periodUs / 1e6);
+}
+
+/* Fork Prometheus listener on 127.0.0.1:port, metrics stay local
+ * unless scraper is on the same host or tunnelled. Returns its pid */
+pid_t metStart(int port, acq_shared_s *shm)
+{
+  struct sockaddr_in addr;
+  int ssck, optval = 1;
+  pid_t pid;
+
+  ssck = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (ssck == -1)
+    errExit("socket(metrics)");
+  if (setsockopt(ssck, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof optval) == -1)
+    errExit("setsockopt(metrics)");
+
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(ssck, (struct sockaddr *)&addr, sizeof addr) == -1)
+    errExit("bind(metrics 127.0.0.1:%d)", port);
+  if (listen(ssck, 10) == -1)
+    errExit("listen(metrics)");
+
+  switch (pid = fork()) {
+  case -1:
+    errExit("fork(metrics)");
+
+  case 0:
+    // Do not outlive the server
+    if (prctl(PR_SET_PDEATHSIG, SIGTERM) == -1)
+      errMsg("prctl(PR_SET_PDEATHSIG)");
+    if (getppid() == 1)
+      _exit(EXIT_FAILURE);
+
+    metServe(ssck, shm);
+    _exit(EXIT_FAILURE);
+
+  default:
+    close(ssck);
+    return pid;
+  }
+}
+
+/***************** Local Functions Definitions ******************/
+
+static uint64_t load(const uint64_t *p)
+{
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+// Upper bound in us of bucket holding pct percentile
+static double histPercentileUs(const met_hist_s *h, double pct)
+{
+  uint64_t want, seen = 0;
+  int k;
+
+  want = (uint64_t)(load(&h->count) * pct / 100.0 + 0.5);
+  if (want == 0)
+    want = 1;
+  for (k = 0; k < MET_BUCKETS - 1; k++) {
+    seen += load(&h->bucket[k]);
+    if (seen >= want)
+      return (double)(1LL << k);
+  }
+
+  // Beyond the last bound, report the bound
+  return (double)(1LL << (MET_BUCKETS - 2));
+}
+
+/* Serve scrapes one by one, every request gets the whole text. Reply
+ * is HTTP/1.0, connection closes after it */
+static void metServe(int ssck, acq_shared_s *shm)
+{
+  struct timeval tv = { MET_SOCK_TIMEOUT_S, 0 };
+  char req[1024];
+  FILE *fp;
+  int csck;
+
+  signal(SIGPIPE, SIG_IGN);
+
+  for (;;) {
+    csck = accept(ssck, NULL, NULL);
+    if (csck == -1) {
+      if (errno != EINTR)
+	errMsg("accept(metrics)");
+      continue;
+    }
+    setsockopt(csck, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    setsockopt(csck, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+
+    // Request itself does not matter, only wait until it came
+    if (read(csck, req, sizeof req) <= 0) {
+      close(csck);
+      continue;
+    }
+
+    fp = fdopen(csck, "w");
+    if (fp == NULL) {
+      close(csck);
+      continue;
+    }
+    fprintf(fp, "HTTP/1.0 200 OK\r\n"
+	    "Content-Type: text/plain; version=0.0.4\r\n\r\n");
+    metProm(shm, fp);
+    fclose(fp);
+  }
+}
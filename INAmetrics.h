@@ -0,0 +1,89 @@
+/*****************************************************************
+ * Title    : INAmetrics.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Server metrics, counters and latency histograms in
+ *            shared memory, updated lock-free by every process and
+ *            reported by "metrics" command and Prometheus listener
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INAMETRICS_H
+#define INAMETRICS_H
+
+/************************** Includes ****************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/************ Global Symbolic Constant Definitions **************/
+
+// Latency histograms, one per command, i2c operation and connection stage
+#define MET_CMD_VOLTAGE   0
+#define MET_CMD_CURRENT   1
+#define MET_CMD_LOG       2
+#define MET_CMD_STATS     3
+#define MET_CMD_ENERGY    4
+#define MET_CMD_STREAM    5
+#define MET_CMD_PROTO     6
+#define MET_CMD_CONFIG    7
+#define MET_CMD_STOP      8
+#define MET_CMD_EXIT      9
+#define MET_CMD_METRICS   10
+#define MET_CMD_BATCH     11
+#define MET_CMD_TRIGGER   12
+#define MET_CMD_HISTORY   13
+#define MET_CMD_REPORT    14
+#define MET_CMD_UNKNOWN   15
+#define MET_I2C_BURST     16    // Burst read of measurement registers
+#define MET_I2C_READ      17    // Single register read
+#define MET_I2C_WRITE     18    // Single register write
+#define MET_CONN_SPAWN    19    // accept() return to serving the client
+#define MET_CONN_LIFE     20    // Connection lifetime
+#define MET_SOCK_WRITE    21    // write() of replies to client socket
+#define MET_TS_FORMAT     22    // Timestamp formatting, once a second
+#define MET_HISTS         23
+
+// Counters
+#define MET_CONN_ACCEPTED 0
+#define MET_CONN_CLOSED   1
+#define MET_BYTES_IN      2
+#define MET_BYTES_OUT     3
+#define MET_WRITE_AGAIN   4     // Socket did not take whole reply
+#define MET_CONN_REFUSED  5     // Local peer failed credential check
+#define MET_COUNTERS      6
+
+/* Bucket k counts observations up to 2^k us, the last one everything
+ * longer, MET_BUCKETS - 2 is about 4 s */
+#define MET_BUCKETS       24
+
+/**************** New Global Types Definitions ******************/
+
+typedef struct met_hist {
+  uint64_t bucket[MET_BUCKETS];
+  uint64_t count;
+  uint64_t sumNs;
+} met_hist_s;
+
+/* Metrics of all server processes, every field is updated by
+ * __atomic_fetch_add() on its own, so snapshot may be a few
+ * observations inconsistent */
+typedef struct met_shared {
+  int64_t startNs;
+  uint64_t counter[MET_COUNTERS];
+  met_hist_s hist[MET_HISTS];
+} met_shared_s;
+
+struct acq_shared;
+
+/************** Global Functions Prototype Declarations *********/
+
+void metCreate(void);
+long long metNow(void);
+void metObserve(int hist, long long ns);
+void metAdd(int counter, uint64_t n);
+void metJson(struct acq_shared *shm, char *buf, size_t size);
+void metProm(struct acq_shared *shm, FILE *fp);
+pid_t metStart(int port, struct acq_shared *shm);
+
+#endif // INAMETRICS_H
@@ -0,0 +1,163 @@
+/*****************************************************************
+ * Title    : INApool.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Pre-forked worker pool of INA219 server. Workers are
+ *            forked in advance and accept on the shared listening
+ *            socket, each serves one client at a time like child
+ *            of fork mode. Server process only keeps the pool full
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <signal.h>
+#include <time.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/error_functions.h"
+#include "INAacq.h"
+#include "INAconn.h"
+#include "INAlocal.h"
+#include "INAmetrics.h"
+#include "INApool.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+// Pause before respawning worker which did not exit by itself
+#define POOL_RESPAWN_NS  100000000L
+
+/************ Static global Variable Definitions ****************/
+
+/* Pid of worker in every slot, 0 once SIGCHLD handler reaped it.
+ * Written by handler, so volatile */
+static volatile pid_t workerPid[POOL_MAX_WORKERS];
+static volatile sig_atomic_t workerFailed;
+static int poolSize;
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static pid_t workerStart(int ssck, int usck, acq_shared_s *shm, long maxConns);
+static void workerLoop(int ssck, int usck, acq_shared_s *shm, long maxConns);
+
+/**************** Global Functions Definitions ******************/
+
+/* Serve clients accepted on TCP listening socket ssck and on local one
+ * usck (-1 if none, see localAccept()) by pool of workers processes,
+ * each of them exits after maxConns connections (0 means never) and is
+ * replaced. Never returns */
+void poolServe(int ssck, int usck, acq_shared_s *shm, int workers,
+	       long maxConns)
+{
+  struct timespec pause = { 0, POOL_RESPAWN_NS };
+  sigset_t chld, prev;
+  int i;
+
+  sigemptyset(&chld);
+  sigaddset(&chld, SIGCHLD);
+
+  /* SIGCHLD is let in only while waiting, so no worker can die
+     between checking slots and suspending */
+  if (sigprocmask(SIG_BLOCK, &chld, &prev) == -1)
+    errExit("sigprocmask(SIGCHLD)");
+
+  poolSize = workers;
+  for (;;) {
+    if (workerFailed) {
+      // Crashing worker must not turn the server into fork loop
+      workerFailed = 0;
+      nanosleep(&pause, NULL);
+    }
+
+    for (i = 0; i < poolSize; i++)
+      if (workerPid[i] == 0)
+	workerPid[i] = workerStart(ssck, usck, shm, maxConns);
+
+    sigsuspend(&prev);
+  }
+}
+
+/* Called by SIGCHLD handler of server for every reaped child. Frees
+ * slot of worker and returns 1 if pid was one, otherwise 0. Only
+ * async-signal-safe things happen here */
+int poolReaped(pid_t pid, int status)
+{
+  int i;
+
+  for (i = 0; i < poolSize; i++)
+    if (workerPid[i] == pid) {
+      workerPid[i] = 0;
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+	workerFailed = 1;
+	// Nowhere to report failed write from signal handler
+	if (write(STDERR_FILENO, "pool worker died\n", 17) == -1) {}
+      }
+      return 1;
+    }
+
+  return 0;
+}
+
+/***************** Local Functions Definitions ******************/
+
+// Fork one worker, pid 0 if it could not be forked this time
+static pid_t workerStart(int ssck, int usck, acq_shared_s *shm, long maxConns)
+{
+  pid_t pid;
+
+  switch (pid = fork()) {
+  case -1:
+    errMsg("fork(worker)");
+    workerFailed = 1;
+    return 0;
+
+  case 0:
+    // Do not outlive the server, nor keep serving its frozen cache
+    if (prctl(PR_SET_PDEATHSIG, SIGTERM) == -1)
+      errMsg("prctl(PR_SET_PDEATHSIG)");
+    if (getppid() == 1)
+      _exit(EXIT_FAILURE);
+
+    workerLoop(ssck, usck, shm, maxConns);
+    _exit(EXIT_SUCCESS);
+
+  default:
+    return pid;
+  }
+}
+
+/* Accept and serve clients one after another. Kernel hands every
+ * connection to one of the workers waiting in accept(), or to the
+ * fastest of them to poll() both listeners when there is local one */
+static void workerLoop(int ssck, int usck, acq_shared_s *shm, long maxConns)
+{
+  sigset_t chld;
+  long served = 0;
+  int csck;
+
+  // Worker has no children, blocked SIGCHLD of pool is not needed
+  sigemptyset(&chld);
+  sigaddset(&chld, SIGCHLD);
+  sigprocmask(SIG_UNBLOCK, &chld, NULL);
+
+  // Peer closing its end must not cost the worker
+  if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
+    errExit("signal(SIGPIPE)");
+
+  while (maxConns == 0 || served < maxConns) {
+    csck = localAccept(ssck, usck);
+    if (csck == -1) {
+      // Another worker was faster or local peer was refused
+      if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN ||
+	  errno == EACCES)
+	continue;
+      errExit("accept(2)");
+    }
+
+    // Worker is ready, client waits for nothing but accept()
+    metObserve(MET_CONN_SPAWN, 0);
+    connServe(csck, shm);
+    served++;
+  }
+}
@@ -0,0 +1,26 @@
+/*****************************************************************
+ * Title    : INApool.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Pre-forked worker pool server mode
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INAPOOL_H
+#define INAPOOL_H
+
+/************************** Includes ****************************/
+#include <sys/types.h>
+#include "INAacq.h"
+
+/************ Global Symbolic Constant Definitions **************/
+
+#define POOL_DEF_WORKERS  4
+#define POOL_MAX_WORKERS  64
+
+/************** Global Functions Prototype Declarations *********/
+
+void poolServe(int ssck, int usck, acq_shared_s *shm, int workers,
+	       long maxConns);
+int poolReaped(pid_t pid, int status);
+
+#endif // INAPOOL_H
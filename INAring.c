@@ -0,0 +1,236 @@
+/*****************************************************************
+ * Title    : INAring.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Producer and consumer side of shared memory sample
+ *            ring described in INAring.h. Functions report errors
+ *            by return value and errno, so consumers do not need
+ *            any of the server's error handling
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "INAring.h"
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static int slotRead(const ring_slot_s *slot, ring_sample_s *smp);
+
+/**************** Global Functions Definitions ******************/
+
+/* Create (or replace) ring shared memory object "name" with "slots"
+ * slots, which must be a power of two. Returns NULL on error */
+ring_hdr_s *ringCreate(const char *name, uint32_t slots, uint32_t periodUs)
+{
+  ring_hdr_s *ring;
+  size_t size;
+  int fd, savedErrno;
+
+  if (slots == 0 || (slots & (slots - 1))) {
+    errno = EINVAL;
+    return NULL;
+  }
+  size = sizeof(ring_hdr_s) + slots * sizeof(ring_slot_s);
+
+  // Old object may still be mapped by consumers, leave it to them
+  if (shm_unlink(name) == -1 && errno != ENOENT)
+    return NULL;
+
+  fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1)
+    return NULL;
+
+  if (ftruncate(fd, size) == -1) {
+    savedErrno = errno;
+    close(fd);
+    shm_unlink(name);
+    errno = savedErrno;
+    return NULL;
+  }
+
+  ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  savedErrno = errno;
+  close(fd);
+  if (ring == MAP_FAILED) {
+    shm_unlink(name);
+    errno = savedErrno;
+    return NULL;
+  }
+
+  // ftruncate() zeroed the object, so head is 0 and every lock even
+  ring->slotSize = sizeof(ring_slot_s);
+  ring->slots = slots;
+  ring->periodUs = periodUs;
+  ring->version = RING_VERSION;
+  __atomic_store_n(&ring->magic, RING_MAGIC, __ATOMIC_RELEASE);
+
+  return ring;
+}
+
+// Publish one sample, only the single producer calls it
+void ringPush(ring_hdr_s *ring, const ring_sample_s *smp)
+{
+  ring_slot_s *slot = &ring->slot[smp->seq & (ring->slots - 1)];
+  uint32_t lock;
+
+  lock = __atomic_load_n(&slot->lock, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->lock, lock + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  slot->seq = smp->seq;
+  slot->tsNs = smp->tsNs;
+  slot->err = smp->err;
+  slot->shuntRegVal = smp->shuntRegVal;
+  slot->busRegVal = smp->busRegVal;
+  slot->currRegVal = smp->currRegVal;
+  slot->powerRegVal = smp->powerRegVal;
+  slot->currLsbA = smp->currLsbA;
+
+  __atomic_store_n(&slot->lock, lock + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->head, smp->seq, __ATOMIC_RELEASE);
+}
+
+/* Put name of ring of channel ch in buf. Channel 0 keeps the plain
+ * name, others get ".<channel>" suffix, e.g. "/INA219.1" */
+void ringChanName(char *buf, size_t size, const char *name, int ch)
+{
+  if (ch == 0)
+    snprintf(buf, size, "%s", name);
+  else
+    snprintf(buf, size, "%s.%d", name, ch);
+}
+
+/* Map ring "name" read-only. Reader starts after the latest sample,
+ * so the first ringNext() returns the next one published.
+ * Returns -1 on error, errno EPROTO if object is not a known ring */
+int ringOpen(ring_reader_s *rd, const char *name)
+{
+  const ring_hdr_s *hdr;
+  struct stat sb;
+  int fd, savedErrno;
+
+  fd = shm_open(name, O_RDONLY, 0);
+  if (fd == -1)
+    return -1;
+
+  if (fstat(fd, &sb) == -1) {
+    savedErrno = errno;
+    close(fd);
+    errno = savedErrno;
+    return -1;
+  }
+  if ((size_t)sb.st_size < sizeof(ring_hdr_s)) {
+    close(fd);
+    errno = EPROTO;
+    return -1;
+  }
+
+  hdr = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  savedErrno = errno;
+  close(fd);
+  if (hdr == MAP_FAILED) {
+    errno = savedErrno;
+    return -1;
+  }
+
+  if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != RING_MAGIC ||
+      hdr->version != RING_VERSION || hdr->slotSize != sizeof(ring_slot_s) ||
+      hdr->slots == 0 || (hdr->slots & (hdr->slots - 1)) ||
+      sizeof(ring_hdr_s) + (size_t)hdr->slots * sizeof(ring_slot_s) > (size_t)sb.st_size) {
+    munmap((void *)hdr, sb.st_size);
+    errno = EPROTO;
+    return -1;
+  }
+
+  rd->hdr = hdr;
+  rd->mapSize = sb.st_size;
+  rd->next = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE) + 1;
+  rd->lost = 0;
+
+  return 0;
+}
+
+/* Take next sample in order. Returns 1 if smp was filled, 0 if no
+ * newer sample is published yet. If reader fell more than a ring
+ * behind, it skips to the oldest sample still kept and counts the
+ * skipped ones in rd->lost */
+int ringNext(ring_reader_s *rd, ring_sample_s *smp)
+{
+  const ring_hdr_s *hdr = rd->hdr;
+  uint32_t head, oldest;
+
+  for (;;) {
+    head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+    if ((int32_t)(head - rd->next) < 0)
+      return 0;
+
+    oldest = head - hdr->slots + 1;
+    if ((int32_t)(oldest - rd->next) > 0) {
+      rd->lost += oldest - rd->next;
+      rd->next = oldest;
+    }
+
+    if (slotRead(&hdr->slot[rd->next & (hdr->slots - 1)], smp) &&
+	smp->seq == rd->next) {
+      rd->next++;
+      return 1;
+    }
+    // Producer lapped us while copying, look at head again
+  }
+}
+
+/* Take the latest sample, skipping whatever was not read yet.
+ * Returns 1 if smp was filled, 0 if nothing was published so far */
+int ringLatest(ring_reader_s *rd, ring_sample_s *smp)
+{
+  const ring_hdr_s *hdr = rd->hdr;
+  uint32_t head;
+
+  do {
+    head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+    if (head == 0)
+      return 0;
+  } while (!slotRead(&hdr->slot[head & (hdr->slots - 1)], smp) ||
+	   smp->seq != head);
+
+  rd->next = head + 1;
+  return 1;
+}
+
+void ringClose(ring_reader_s *rd)
+{
+  munmap((void *)rd->hdr, rd->mapSize);
+  rd->hdr = NULL;
+}
+
+/***************** Local Functions Definitions ******************/
+
+/* Seqlock read of one slot, returns 0 if producer was writing it
+ * meanwhile and the copy may be torn */
+static int slotRead(const ring_slot_s *slot, ring_sample_s *smp)
+{
+  uint32_t lock1, lock2;
+
+  lock1 = __atomic_load_n(&slot->lock, __ATOMIC_ACQUIRE);
+
+  smp->seq = slot->seq;
+  smp->tsNs = slot->tsNs;
+  smp->err = slot->err;
+  smp->shuntRegVal = slot->shuntRegVal;
+  smp->busRegVal = slot->busRegVal;
+  smp->currRegVal = slot->currRegVal;
+  smp->powerRegVal = slot->powerRegVal;
+  smp->currLsbA = slot->currLsbA;
+
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  lock2 = __atomic_load_n(&slot->lock, __ATOMIC_RELAXED);
+
+  return !(lock1 & 1) && lock1 == lock2;
+}
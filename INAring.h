@@ -0,0 +1,117 @@
+/*****************************************************************
+ * Title    : INAring.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Lock-free single producer / multi consumer ring of
+ *            INA219 samples in POSIX shared memory (/dev/shm), so
+ *            local processes read samples without any socket.
+ *            Self-contained, consumers need only this header and
+ *            INAring.c (link with -lrt on older glibc)
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INARING_H
+#define INARING_H
+
+/* Layout of shared memory object, host byte order:
+ *
+ *   offset size
+ *     0     4   magic     RING_MAGIC
+ *     4     2   version   RING_VERSION
+ *     6     2   slotSize  size of one slot, 32
+ *     8     4   slots     number of slots, power of two
+ *    12     4   periodUs  current conversion period
+ *    16     4   head      seq of latest published sample, 0 = none
+ *    20    44   reserved
+ *    64   ...   slot[slots]
+ *
+ * Slot, sample with seq is kept in slot[seq & (slots - 1)]:
+ *
+ *     0     4   lock      odd while producer rewrites the slot
+ *     4     4   seq       sample sequence number, increments by one
+ *     8     8   tsNs      sample time, ns since Epoch (UTC)
+ *    16     4   err       bits of registers which failed to read
+ *    20     2   shunt     shunt voltage register
+ *    22     2   bus       bus voltage register, CNVR bit 1 is set
+ *                         if sample carries a new conversion
+ *    24     2   current   current register
+ *    26     2   power     power register
+ *    28     4   currLsb   current LSB in A (float), power LSB is 20x
+ *
+ * Producer writes slot under its lock and then stores head. Consumer
+ * copies slot out and takes it only if lock was even and unchanged
+ * and seq is the one expected, otherwise slot was overwritten.
+ *
+ * Server sampling several INA219 devices keeps one ring per device,
+ * see ringChanName() */
+
+/************************** Includes ****************************/
+#include <stdint.h>
+#include <stddef.h>
+
+/************ Global Symbolic Constant Definitions **************/
+
+#define RING_NAME     "/INA219"       // Default shm_open() name
+#define RING_MAGIC    0x52414e49      // "INAR"
+#define RING_VERSION  1
+#define RING_SLOTS    4096
+
+/**************** New Global Types Definitions ******************/
+
+// One sample as handed over to consumer, raw register values
+typedef struct ring_sample {
+  uint32_t seq;
+  int32_t err;
+  int64_t tsNs;
+  int16_t shuntRegVal;
+  int16_t busRegVal;
+  int16_t currRegVal;
+  int16_t powerRegVal;
+  float currLsbA;
+} ring_sample_s;
+
+// Slot as laid out in shared memory, see layout above
+typedef struct ring_slot {
+  uint32_t lock;
+  uint32_t seq;
+  int64_t tsNs;
+  int32_t err;
+  int16_t shuntRegVal;
+  int16_t busRegVal;
+  int16_t currRegVal;
+  int16_t powerRegVal;
+  float currLsbA;
+} ring_slot_s;
+
+typedef struct ring_hdr {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t slotSize;
+  uint32_t slots;
+  uint32_t periodUs;
+  uint32_t head;
+  char reserved[44];
+  ring_slot_s slot[];
+} ring_hdr_s;
+
+// Consumer side handle
+typedef struct ring_reader {
+  const ring_hdr_s *hdr;
+  size_t mapSize;
+  uint32_t next;                // seq of sample ringNext() returns next
+  unsigned long lost;           // Samples overwritten before being read
+} ring_reader_s;
+
+/************** Global Functions Prototype Declarations *********/
+
+// Producer
+ring_hdr_s *ringCreate(const char *name, uint32_t slots, uint32_t periodUs);
+void ringPush(ring_hdr_s *ring, const ring_sample_s *smp);
+
+// Consumers
+void ringChanName(char *buf, size_t size, const char *name, int ch);
+int ringOpen(ring_reader_s *rd, const char *name);
+int ringNext(ring_reader_s *rd, ring_sample_s *smp);
+int ringLatest(ring_reader_s *rd, ring_sample_s *smp);
+void ringClose(ring_reader_s *rd);
+
+#endif // INARING_H
@@ -0,0 +1,486 @@
+/*****************************************************************
+ * Title    : INAsim.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Simulated INA219 described in INAsim.h. Conversions
+ *            are not run by a timer, registers are brought up to
+ *            date whenever they are accessed, from the time passed
+ *            since configuration register was written
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../header/INA219.h"
+#include "INAburst.h"
+#include "INAconf.h"
+#include "INAacq.h"
+#include "INAsim.h"
+
+/************ Local Symbolic Constant Definitions ***************/
+
+#define SIM_REGS          6             // config_reg .. calib_reg
+#define SIM_CONF_RESET    0x8000
+#define SIM_CONF_DEFAULT  0x399f        // Power-on value of INA219
+#define SIM_SHUNT_LSB_V   10e-6
+#define SIM_BUS_LSB_V     4e-3
+#define SIM_BUS_MAX       0x1fff        // 13 bit bus voltage value
+#define SIM_SPEC_SIZE     512
+
+// Waveforms of load current
+#define WAVE_CONST  0
+#define WAVE_PWM    1
+#define WAVE_RAMP   2
+#define WAVE_TRACE  3
+
+/**************** New Local Types Definitions *******************/
+
+// One line of recorded trace
+typedef struct sim_point {
+  double t;                     // s from start of trace
+  double amp;
+  double volt;
+} sim_point_s;
+
+// State of one simulated INA219, ina_bus_s.dev
+typedef struct sim_dev {
+  short reg[SIM_REGS];          // Indexed by register pointer
+  int wave;
+  double amp, amp2, volt;
+  double hz, duty;
+  double rOhm;
+  double noiseA;
+  double fail;
+  long latUs;
+  long convUs;
+  sim_point_s *trace;
+  int ntrace;
+  int64_t openNs;               // Waveform time zero
+  int64_t startNs;              // Conversions are counted from here,
+  int64_t latched;              // number of them latched so far
+  unsigned int seed;
+} sim_dev_s;
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static int simRegRead(ina_bus_s *bus, unsigned char reg, short *val);
+static int simRegWrite(ina_bus_s *bus, unsigned char reg, short val);
+static int simBurstRead(ina_bus_s *bus, ina_burst_s *regs);
+static void simClose(ina_bus_s *bus);
+static int simTransfer(sim_dev_s *sim, int measure);
+static short simGet(sim_dev_s *sim, unsigned char reg);
+static void simUpdate(sim_dev_s *sim);
+static void simConvert(sim_dev_s *sim, int64_t tNs);
+static void waveAt(sim_dev_s *sim, double t, double *amp, double *volt);
+static int specKey(sim_dev_s *sim, char *key, char *err, size_t errSize);
+static int traceLoad(sim_dev_s *sim, const char *path, char *err,
+		     size_t errSize);
+
+/************ Static global Variable Definitions ****************/
+
+static const ina_ops_s simOps = {
+  simRegRead, simRegWrite, simBurstRead, simClose
+};
+
+/**************** Global Functions Definitions ******************/
+
+/* Make bus a simulated INA219 at addr described by spec (see
+ * INAsim.h). Device starts in power-on state, like a real one.
+ * Returns -1 with reason in err if spec is wrong */
+int simOpen(ina_bus_s *bus, const char *spec, int addr, char *err,
+	    size_t errSize)
+{
+  char buf[SIM_SPEC_SIZE];
+  char *key, *save;
+  sim_dev_s *sim;
+
+  if (strlen(spec) >= sizeof buf) {
+    snprintf(err, errSize, "simulated device spec too long");
+    return -1;
+  }
+  strcpy(buf, spec);
+
+  sim = calloc(1, sizeof(sim_dev_s));
+  if (sim == NULL) {
+    snprintf(err, errSize, "calloc(sim_dev_s): %s", strerror(errno));
+    return -1;
+  }
+  sim->wave = WAVE_CONST;
+  sim->amp = 0.1;
+  sim->volt = 5.0;
+  sim->hz = 1.0;
+  sim->duty = 0.5;
+  sim->rOhm = CONF_DEF_RSHUNT;
+  sim->reg[config_reg] = SIM_CONF_DEFAULT;
+  sim->seed = addr;
+
+  // First token is the prefix itself
+  strtok_r(buf, ",", &save);
+  while ((key = strtok_r(NULL, ",", &save)) != NULL)
+    if (specKey(sim, key, err, errSize) == -1) {
+      free(sim->trace);
+      free(sim);
+      return -1;
+    }
+
+  if (sim->wave == WAVE_TRACE && sim->ntrace == 0) {
+    snprintf(err, errSize, "simulated device: wave=trace needs file=<trace>");
+    free(sim->trace);
+    free(sim);
+    return -1;
+  }
+
+  sim->openNs = acqNowNs();
+  sim->startNs = sim->openNs;
+
+  bus->ops = &simOps;
+  bus->fd = -1;
+  bus->addr = addr;
+  bus->rdwr = 1;
+  bus->dev = sim;
+
+  return 0;
+}
+
+/***************** Local Functions Definitions ******************/
+
+static int simRegRead(ina_bus_s *bus, unsigned char reg, short *val)
+{
+  sim_dev_s *sim = bus->dev;
+
+  if (reg >= SIM_REGS) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (simTransfer(sim, reg != config_reg && reg != calib_reg) == -1)
+    return -1;
+
+  simUpdate(sim);
+  *val = simGet(sim, reg);
+  return 0;
+}
+
+/* Configuration write starts conversions over, or resets device with
+ * RST bit. Measurement registers are read-only, writes are ignored */
+static int simRegWrite(ina_bus_s *bus, unsigned char reg, short val)
+{
+  sim_dev_s *sim = bus->dev;
+
+  if (reg >= SIM_REGS) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (simTransfer(sim, 0) == -1)
+    return -1;
+
+  if (reg == config_reg) {
+    if (val & SIM_CONF_RESET) {
+      memset(sim->reg, 0, sizeof sim->reg);
+      val = SIM_CONF_DEFAULT;
+    }
+    sim->reg[config_reg] = val;
+    sim->reg[bus_volt_reg] &= ~(CNVR | OVF);
+    sim->startNs = acqNowNs();
+    sim->latched = 0;
+  }
+  else if (reg == calib_reg) {
+    // Bit 0 of calibration register is not used
+    sim->reg[calib_reg] = val & ~1;
+  }
+
+  return 0;
+}
+
+// Combined transfer is one transaction, all registers of one conversion
+static int simBurstRead(ina_bus_s *bus, ina_burst_s *regs)
+{
+  sim_dev_s *sim = bus->dev;
+
+  if (simTransfer(sim, 1) == -1)
+    return BURST_ALL;
+
+  simUpdate(sim);
+  regs->shuntRegVal = simGet(sim, shunt_volt_reg);
+  regs->busRegVal = simGet(sim, bus_volt_reg);
+  regs->powerRegVal = simGet(sim, power_data_reg);
+  regs->currRegVal = simGet(sim, curr_data_reg);
+
+  return 0;
+}
+
+static void simClose(ina_bus_s *bus)
+{
+  sim_dev_s *sim = bus->dev;
+
+  free(sim->trace);
+  free(sim);
+  bus->dev = NULL;
+}
+
+/* Time of one i2c transaction and random failure of measurement
+ * read, setup of device always succeeds. Returns -1 with errno EIO
+ * if transaction fails */
+static int simTransfer(sim_dev_s *sim, int measure)
+{
+  struct timespec ts;
+
+  if (sim->latUs > 0) {
+    ts.tv_sec = sim->latUs / 1000000;
+    ts.tv_nsec = sim->latUs % 1000000 * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR)
+      ;
+  }
+
+  if (measure && sim->fail > 0 && rand_r(&sim->seed) < sim->fail * RAND_MAX) {
+    errno = EIO;
+    return -1;
+  }
+
+  return 0;
+}
+
+// Register value as read, reading power register clears CNVR
+static short simGet(sim_dev_s *sim, unsigned char reg)
+{
+  short val = sim->reg[reg];
+
+  if (reg == power_data_reg)
+    sim->reg[bus_volt_reg] &= ~CNVR;
+
+  return val;
+}
+
+/* Latch conversion which completed since the last access. Continuous
+ * modes convert every period from configuration write on, triggered
+ * ones once, power-down and ADC off never */
+static void simUpdate(sim_dev_s *sim)
+{
+  short conf = sim->reg[config_reg];
+  int64_t periodNs, n;
+
+  if (!(conf & (CONF_MODE_SHUNT | CONF_MODE_BUS)))
+    return;
+
+  periodNs = (sim->convUs ? sim->convUs : acqConvPeriodUs(conf)) * 1000LL;
+  if (periodNs <= 0)
+    return;
+
+  n = (acqNowNs() - sim->startNs) / periodNs;
+  if (!(conf & CONF_MODE_CONT) && n > 1)
+    n = 1;
+  if (n <= sim->latched)
+    return;
+
+  // Conversion averages its whole period, take the middle of it
+  sim->latched = n;
+  simConvert(sim, sim->startNs + n * periodNs - periodNs / 2);
+}
+
+/* Convert load at time tNs into register values, datasheet
+ * equations 4 and 5 for current and power */
+static void simConvert(sim_dev_s *sim, int64_t tNs)
+{
+  short conf = sim->reg[config_reg];
+  double amp, volt, shuntV, range;
+  long shunt, bus, curr, power;
+  int ovf = 0;
+
+  waveAt(sim, (tNs - sim->openNs) / 1e9, &amp, &volt);
+  if (sim->noiseA > 0)
+    amp += sim->noiseA * (2.0 * rand_r(&sim->seed) / RAND_MAX - 1.0);
+
+  // PGA range is 40 mV times gain
+  shuntV = amp * sim->rOhm;
+  range = 0.04 * (1 << ((conf >> CONF_PGA_SHIFT) & CONF_PGA_MASK));
+  if (shuntV > range || shuntV < -range) {
+    shuntV = (shuntV > 0) ? range : -range;
+    ovf = 1;
+  }
+  shunt = lround(shuntV / SIM_SHUNT_LSB_V);
+
+  if (volt > ((conf & CONF_BRNG) ? 32.0 : 16.0))
+    volt = (conf & CONF_BRNG) ? 32.0 : 16.0;
+  bus = lround(volt / SIM_BUS_LSB_V);
+  if (bus < 0)
+    bus = 0;
+  if (bus > SIM_BUS_MAX)
+    bus = SIM_BUS_MAX;
+
+  curr = shunt * (unsigned short)sim->reg[calib_reg] / 4096;
+  if (curr > SHRT_MAX || curr < SHRT_MIN) {
+    curr = (curr > 0) ? SHRT_MAX : SHRT_MIN;
+    ovf = 1;
+  }
+  power = labs(curr) * bus / 5000;
+  if (power > USHRT_MAX) {
+    power = USHRT_MAX;
+    ovf = 1;
+  }
+
+  sim->reg[shunt_volt_reg] = shunt;
+  sim->reg[bus_volt_reg] = (bus << 3) | CNVR | (ovf ? OVF : 0);
+  sim->reg[curr_data_reg] = curr;
+  sim->reg[power_data_reg] = power;
+}
+
+// Load current and bus voltage at t s after device was opened
+static void waveAt(sim_dev_s *sim, double t, double *amp, double *volt)
+{
+  double phase = t * sim->hz - floor(t * sim->hz);
+  double len;
+  int lo, hi, mid;
+
+  *amp = sim->amp;
+  *volt = sim->volt;
+
+  switch (sim->wave) {
+  case WAVE_PWM:
+    *amp = (phase < sim->duty) ? sim->amp : sim->amp2;
+    break;
+
+  case WAVE_RAMP:
+    *amp = sim->amp + (sim->amp2 - sim->amp) * phase;
+    break;
+
+  case WAVE_TRACE:
+    // Replayed in loop, last point whose time has come
+    len = sim->trace[sim->ntrace - 1].t;
+    if (len > 0)
+      t = fmod(t, len);
+    for (lo = 0, hi = sim->ntrace - 1; lo < hi; ) {
+      mid = (lo + hi + 1) / 2;
+      if (sim->trace[mid].t <= t)
+	lo = mid;
+      else
+	hi = mid - 1;
+    }
+    *amp = sim->trace[lo].amp;
+    *volt = sim->trace[lo].volt;
+    break;
+
+  default:
+    break;
+  }
+}
+
+// Apply one "key=value" of spec
+static int specKey(sim_dev_s *sim, char *key, char *err, size_t errSize)
+{
+  static const char *waves[] = { "const", "pwm", "ramp", "trace" };
+  char *val, *end;
+  double num;
+  int i;
+
+  val = strchr(key, '=');
+  if (val == NULL || val[1] == '\0') {
+    snprintf(err, errSize, "simulated device: '%s' is not key=value", key);
+    return -1;
+  }
+  *val++ = '\0';
+
+  if (!strcmp(key, "wave")) {
+    for (i = 0; i < 4; i++)
+      if (!strcmp(val, waves[i]))
+	sim->wave = i;
+    if (strcmp(val, waves[sim->wave])) {
+      snprintf(err, errSize, "simulated device: unknown wave '%s'", val);
+      return -1;
+    }
+    return 0;
+  }
+  if (!strcmp(key, "file"))
+    return traceLoad(sim, val, err, errSize);
+
+  num = strtod(val, &end);
+  if (*end != '\0') {
+    snprintf(err, errSize, "simulated device: %s=%s is not a number", key, val);
+    return -1;
+  }
+
+  if (!strcmp(key, "i"))
+    sim->amp = num;
+  else if (!strcmp(key, "i2"))
+    sim->amp2 = num;
+  else if (!strcmp(key, "v") && num >= 0)
+    sim->volt = num;
+  else if (!strcmp(key, "hz") && num >= 0)
+    sim->hz = num;
+  else if (!strcmp(key, "duty") && num >= 0 && num <= 1)
+    sim->duty = num;
+  else if (!strcmp(key, "r") && num > 0)
+    sim->rOhm = num;
+  else if (!strcmp(key, "noise") && num >= 0)
+    sim->noiseA = num;
+  else if (!strcmp(key, "lat") && num >= 0)
+    sim->latUs = (long)num;
+  else if (!strcmp(key, "conv") && num >= 0)
+    sim->convUs = (long)num;
+  else if (!strcmp(key, "fail") && num >= 0 && num <= 1)
+    sim->fail = num;
+  else {
+    snprintf(err, errSize, "simulated device: unknown key or bad value %s=%s",
+	     key, val);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Read trace file, lines "<time-s> <current-A> [<bus-V>]" with time
+ * not going back, '#' starts a comment line. Bus voltage left out
+ * is v of spec given before file */
+static int traceLoad(sim_dev_s *sim, const char *path, char *err,
+		     size_t errSize)
+{
+  sim_point_s pt, *grown;
+  char line[256];
+  int alloc = 0, lineNo = 0, n;
+  FILE *fp;
+
+  fp = fopen(path, "r");
+  if (fp == NULL) {
+    snprintf(err, errSize, "simulated device: %s: %s", path, strerror(errno));
+    return -1;
+  }
+
+  free(sim->trace);
+  sim->trace = NULL;
+  sim->ntrace = 0;
+
+  while (fgets(line, sizeof line, fp) != NULL) {
+    lineNo++;
+    if (line[strspn(line, " \t\r\n")] == '\0' || line[0] == '#')
+      continue;
+
+    pt.volt = sim->volt;
+    n = sscanf(line, "%lf %lf %lf", &pt.t, &pt.amp, &pt.volt);
+    if (n < 2 || pt.t < 0 ||
+	(sim->ntrace > 0 && pt.t < sim->trace[sim->ntrace - 1].t)) {
+      snprintf(err, errSize, "simulated device: %s:%d: bad trace line",
+	       path, lineNo);
+      fclose(fp);
+      return -1;
+    }
+
+    if (sim->ntrace == alloc) {
+      alloc = alloc ? 2 * alloc : 256;
+      grown = realloc(sim->trace, alloc * sizeof(sim_point_s));
+      if (grown == NULL) {
+	snprintf(err, errSize, "realloc(trace): %s", strerror(errno));
+	fclose(fp);
+	return -1;
+      }
+      sim->trace = grown;
+    }
+    sim->trace[sim->ntrace++] = pt;
+  }
+
+  fclose(fp);
+  return 0;
+}
@@ -0,0 +1,52 @@
+/*****************************************************************
+ * Title    : INAsim.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Simulated INA219 device backend, so server runs and
+ *            can be benchmarked without hardware
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INASIM_H
+#define INASIM_H
+
+/* Simulated device is selected by bus path (-d or positional one)
+ * "sim[,key=value]...", e.g.
+ *
+ *   sim,wave=pwm,i=0.8,i2=0.05,hz=10,duty=0.25,lat=120
+ *
+ *   wave   const | pwm | ramp | trace          (const)
+ *   i      current in A, pwm high, ramp start  (0.1)
+ *   i2     pwm low, ramp end current in A      (0)
+ *   v      bus voltage in V                    (5)
+ *   hz     pwm and ramp frequency              (1)
+ *   duty   pwm duty cycle, 0..1                (0.5)
+ *   file   trace, lines "<time-s> <current-A> [<bus-V>]", replayed
+ *          in loop, every value held until next line
+ *   r      shunt resistor in Ohm               (0.1)
+ *   noise  uniform current noise, +-A          (0)
+ *   lat    i2c transaction time in us          (0)
+ *   conv   conversion period in us, 0 = from ADC settings (0)
+ *   fail   probability of failed measurement read (0)
+ *
+ * Register map works as in INA219: conversions run in the mode of
+ * configuration register and latch shunt and bus voltage, current
+ * and power are computed from calibration register, bus voltage
+ * register carries CNVR and OVF, reading power register clears CNVR.
+ * Devices on the same bus path share one acquisition worker, as on
+ * real bus, each has its own waveform state */
+
+/************************** Includes ****************************/
+#include <stddef.h>
+#include "INAburst.h"
+
+/************ Global Symbolic Constant Definitions **************/
+
+// Bus path prefix which selects simulated INA219
+#define BUS_SIM_PREFIX  "sim"
+
+/************** Global Functions Prototype Declarations *********/
+
+int simOpen(ina_bus_s *bus, const char *spec, int addr, char *err,
+	    size_t errSize);
+
+#endif // INASIM_H
@@ -5,7 +5,11 @@
  * Brief    : INA219 server using fork to handle
  *            concurrent client accesses
  * Version  : 1.0
- * Options  : <eth0|wlan0> </dev/i2c-*>
+ * Options  : [-m fork|epoll|prefork] [-w workers[,max-conns]]
+ *            [-t reactors] [-b backlog] [-r shm-name] [-c "key value ..."]
+ *            [-l log-dir] [-p metrics-port] [-g group:port] [-u path[,group]]
+ *            [-d "</dev/i2c-*> <addr> [key value ...]"]...
+ *            <eth0|wlan0> [/dev/i2c-*]
  ****************************************************************/
 //#define _FILE_OFFSET_BITS 64
 #define SELF
@@ -16,6 +20,8 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <ctype.h>
+#include <grp.h>
+#include <limits.h>
 #include <wait.h>
 #include <signal.h>
 #include <linux/i2c-dev.h>
@@ -29,6 +35,19 @@
 #include "../header/INA219.h"
 #include "../../rpi_programming/i2c/header/i2c.h"
 #include "../../rpi_programming/header/curr_time.h"
+#include "INAacq.h"
+#include "INAburst.h"
+#include "INAconf.h"
+#include "INAring.h"
+#include "INAlog.h"
+#include "INAcmd.h"
+#include "INAconn.h"
+#include "INAepoll.h"
+#include "INAmetrics.h"
+#include "INApool.h"
+#include "INAmcast.h"
+#include "INAlocal.h"
+#include "INAsim.h"
 
 /***************** Global Variable Definitions ******************/
 // Usually put in dedicated header file with specifier "extern"
@@ -42,6 +61,25 @@
 #define BUF_SIZE 1024
 #endif
 
+#define USAGE "%s [-m fork|epoll|prefork] [-w workers[,max-conns]] [-t reactors]\n" \
+  "\t[-b backlog] [-r shm-name] [-c \"key value ...\"] [-l log-dir] [-p metrics-port] [-g group:port] [-u path[,group]] [-d \"</dev/i2c-*> <addr> [key value ...]\"]... <eth0|wlan0> [/dev/i2c-*]\n" \
+  "Without -d single INA219 at 0x40 on </dev/i2c-*> is sampled,\n" \
+  "bus \"sim[,key=value]...\" is simulated INA219 (see INAsim.h),\n" \
+  "-p serves Prometheus metrics on 127.0.0.1:<metrics-port>,\n" \
+  "-w sizes prefork pool, worker is replaced after max-conns clients,\n" \
+  "-t runs epoll reactor thread per core (0 = all online cores),\n" \
+  "-g multicasts every sample to group:port from the server interface,\n" \
+  "-u serves local clients on Unix socket path (@name is abstract), only\n" \
+  "\troot, server's user and members of group if given\n"
+
+// Ways of serving clients, chosen by -m option
+#define SRV_FORK   0              // One forked child per connection
+#define SRV_EPOLL  1              // Single process epoll reactor
+#define SRV_PREFORK 2             // Pool of workers forked in advance
+
+// Accept queue of listening socket unless -b says otherwise
+#define SRV_BACKLOG 10
+
 /**************** New Local Types Definitions *******************/
 // Uses "typedef" keyword to define new type
 
@@ -50,19 +88,58 @@
 /************ Static global Variable Definitions ****************/
 // Must be labeled "static"
 
+static pid_t acqPid[ACQ_MAX_CHAN];      // Acquisition workers, one per bus
+static int acqWorkers;
+static pid_t logPid;                    // Sample logger, 0 if none
+static pid_t metPid;                    // Metrics listener, 0 if none
+static pid_t mcastPid;                  // Multicast publisher, 0 if none
+
+// Bus paths served by other backend than i2c adapter
+static const ina_backend_s busBackends[] = {
+  { BUS_SIM_PREFIX, simOpen },
+  { NULL, NULL }
+};
+
 
 
 //******** Static Local Functions Prototype Declarations ********/
 // Use full prototype declarations. Must be labeled "static"
+static void inaSetup(acq_dev_s *dev, const char *confArgs, char *devArgs);
+static int reusePortListen(struct sockaddr_in *addr, int backlog);
+static void busObserve(int op, long long ns);
+static void sigWrite(const char *msg);
+
+// Register access of every bus goes to metrics
+static const ina_timing_s busTiming = { metNow, busObserve };
+
 static void sigChldHandler(int sig)
 {
   int savedErrno;
+  pid_t pid;
+  int status;
+  int i;
 
   savedErrno = errno;
 
-  // Catch all exiting child processes 
-  while (waitpid(-1, NULL, WNOHANG) > 0)
-    continue;
+  /* Catch all exiting child processes. Without acquisition process
+     there is nobody to refresh the samples, so server must go too */
+  while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    for (i = 0; i < acqWorkers; i++)
+      if (pid == acqPid[i]) {
+	sigWrite("acquisition process died\n");
+	_exit(EXIT_FAILURE);
+      }
+
+    // Logging is not vital, server goes on without it
+    if (pid == logPid)
+      sigWrite("sample logger died\n");
+    else if (pid == metPid)
+      sigWrite("metrics listener died\n");
+    else if (pid == mcastPid)
+      sigWrite("multicast publisher died\n");
+    else
+      poolReaped(pid, status);        // Pool respawns its workers
+  }
 
   errno = savedErrno;
 }
@@ -77,55 +154,51 @@ int main(int argc, char *argv[])
   
   // File descriptors
   int ssck;                               // Normal listening socket
+  int usck = -1;                          // Local listening socket
   int csck;                               // Client's accepted socket
-  int i2cfd;                              // fd to open i2c device
 
   // Signal handling variables
   struct sigaction sa;
 
   // Networking related variables
   struct sockaddr_in addr_srvr;           // AF_INET
-  struct sockaddr_in addr_clnt;           // AF_INET
   int len_inet;
   int optval = 1;
   //char *srvr_addr = NULL;
 
-  /* Variable related to IO streams both for terminal
-     and for i2c communication */
-  FILE *rx = NULL;
-  FILE *tx = NULL;
-  char buf[BUF_SIZE];
-  
-  char RDbuf[2];
-  int numRead, numWritten;
-
   // Variables related to groups and processes
   pid_t chldPid;
   gid_t rgid, egid;                 // keeping real and effective group id
 
-  /* Variable keeping values from registers
-   * calibration register, configuration register, current register
-   * shunt voltage register and 2nd complement of negative value from
-   * shunt voltage
-   */
-  short confRegVal = 0,
-    calibRegVal = 0;
+  acq_shared_s *acqShm;                   // Latest sample shared cache
+  const char *ringName = RING_NAME;
+  char ringChName[NAME_MAX];
+  char *confArgs = NULL;                  // -c, settings of all devices
+  const char *logDir = NULL;              // -l, sample log directory
+  int metPort = 0;                        // -p, 0 without listener
+  struct in_addr mcastGroup;              // -g, multicast group
+  int mcastPort = 0;                      // -g, 0 without publisher
+  const char *localPath = NULL;           // -u, Unix socket path
+  gid_t localGid = LOCAL_ANY_GID;         // -u, group of local peers
+  struct group *grp;
+  long long acceptNs;
+
+  // Sampled INA219 devices, index is channel number
+  acq_dev_s dev[ACQ_MAX_CHAN];
+  char *devArgs[ACQ_MAX_CHAN];            // -d settings after address
+  char *addrStr, *end;
+  char busErr[160];                       // Why bus could not be opened
+  int ndev = 0, ch;
+
+  // Server mode and command-line options
+  int srvMode = SRV_FORK;
+  int workers = POOL_DEF_WORKERS;         // -w, prefork pool
+  long maxConns = 0;                      // 0 keeps workers forever
+  int reactors = 1;                       // -t, epoll reactor threads
+  int rsck[EPOLL_MAX_REACTORS];           // Their listening sockets
+  int backlog = SRV_BACKLOG;              // -b
+  int opt, i;
 
-  measured_data_s sIna_measuring = {};
-  
-  // Variable keeping real voltage and current values
-  double realShuntVoltVal = 0.0;
-  double realBusVoltVal = 0.0;
-//  double realPowerVal = 0.0;
-  double realCurrVal = 0.0;
-
-  unsigned char configuration = config_reg;
-  unsigned char calibration = calib_reg;
-  unsigned char current = curr_data_reg;
-//  unsigned char power = power_data_reg;
-  unsigned char shunt = shunt_volt_reg;
-  unsigned char bus = bus_volt_reg;
-  
 
   /********************************************************************
    ***************     SIGNAL HANDLERS SETTING      *******************
@@ -166,8 +239,113 @@ int main(int argc, char *argv[])
   rgid = getegid();    
 
   // Check program's command-line config entry
-  if (argc < 3 || strcmp(argv[1], "--help") == 0)
-    usageErr("%s <eth0|wlan0> </dev/i2c-*>\n", argv[0]);
+  while ((opt = getopt(argc, argv, "m:w:t:b:r:c:l:d:p:g:u:")) != -1) {
+    switch (opt) {
+    case 'm':
+      if (strcmp(optarg, "fork") == 0)
+	srvMode = SRV_FORK;
+      else if (strcmp(optarg, "epoll") == 0)
+	srvMode = SRV_EPOLL;
+      else if (strcmp(optarg, "prefork") == 0)
+	srvMode = SRV_PREFORK;
+      else
+	usageErr(USAGE, argv[0]);
+      break;
+
+    case 'w':                   // "workers[,max-conns]"
+      workers = strtol(optarg, &end, 10);
+      if (*end == ',')
+	maxConns = strtol(end + 1, &end, 10);
+      if (*end != '\0' || workers < 1 || workers > POOL_MAX_WORKERS || maxConns < 0)
+	cmdLineErr("-w: 1..%d workers and max-conns >= 0 expected\n",
+		   POOL_MAX_WORKERS);
+      break;
+
+    case 't':                   // 0 is one reactor per online core
+      reactors = getInt(optarg, GN_NONNEG, "reactors");
+      if (reactors == 0)
+	reactors = sysconf(_SC_NPROCESSORS_ONLN);
+      if (reactors < 1 || reactors > EPOLL_MAX_REACTORS)
+	cmdLineErr("-t: 1..%d reactors expected\n", EPOLL_MAX_REACTORS);
+      break;
+
+    case 'b':
+      backlog = getInt(optarg, GN_GT_0, "backlog");
+      break;
+
+    case 'r':
+      ringName = optarg;
+      break;
+
+    case 'c':                   // Same keys as "config" command
+      confArgs = optarg;
+      break;
+
+    case 'l':
+      logDir = optarg;
+      break;
+
+    case 'p':
+      metPort = getInt(optarg, GN_GT_0, "metrics-port");
+      if (metPort > 65535)
+	cmdLineErr("-p: invalid port %d\n", metPort);
+      break;
+
+    case 'g':                   // "group:port"
+      end = strrchr(optarg, ':');
+      if (end == NULL)
+	cmdLineErr("-g: group:port expected\n");
+      *end = '\0';
+      if (inet_aton(optarg, &mcastGroup) == 0 ||
+	  !IN_MULTICAST(ntohl(mcastGroup.s_addr)))
+	cmdLineErr("-g: '%s' is not multicast group\n", optarg);
+      mcastPort = getInt(end + 1, GN_GT_0, "multicast-port");
+      if (mcastPort > 65535)
+	cmdLineErr("-g: invalid port %d\n", mcastPort);
+      break;
+
+    case 'u':                   // "path[,group]"
+      localPath = optarg;
+      end = strrchr(optarg, ',');
+      if (end == NULL)
+	break;
+      *end++ = '\0';
+      if ((grp = getgrnam(end)) != NULL)
+	localGid = grp->gr_gid;
+      else
+	localGid = getInt(end, GN_NONNEG, "-u group");
+      break;
+
+    case 'd':                   // "bus addr [key value ...]"
+      if (ndev == ACQ_MAX_CHAN)
+	cmdLineErr("-d: at most %d devices\n", ACQ_MAX_CHAN);
+      dev[ndev].busPath = strtok_r(optarg, " \t", &devArgs[ndev]);
+      addrStr = strtok_r(NULL, " \t", &devArgs[ndev]);
+      if (dev[ndev].busPath == NULL || addrStr == NULL)
+	cmdLineErr("-d: bus and address expected\n");
+      dev[ndev].addr = strtol(addrStr, &end, 0);
+      if (*end != '\0' || dev[ndev].addr < 0x03 || dev[ndev].addr > 0x77)
+	cmdLineErr("-d: invalid address '%s'\n", addrStr);
+      ndev++;
+      break;
+
+    default:
+      usageErr(USAGE, argv[0]);
+    }
+  }
+
+  if (argc - optind < (ndev ? 1 : 2) || strcmp(argv[optind], "--help") == 0)
+    usageErr(USAGE, argv[0]);
+  if (reactors > 1 && srvMode != SRV_EPOLL)
+    cmdLineErr("-t: reactor threads need -m epoll\n");
+
+  // No -d, the one INA219 server always had
+  if (ndev == 0) {
+    dev[0].busPath = argv[optind + 1];
+    dev[0].addr = INA_SLV_ADDR;
+    devArgs[0] = NULL;
+    ndev = 1;
+  }
 
 #ifdef DEBUG
   printf("Effective gid before opening file:%d\n", (int)rgid);
@@ -178,7 +356,12 @@ int main(int argc, char *argv[])
     errExit("setegid-i2c-openning");
 
   // Open i2c device with INA's slave address to communicate with INA
-  i2cfd = i2c_init(argv[2], INA_SLV_ADDR);
+  for (ch = 0; ch < ndev; ch++) {
+    if (inaBusOpen(&dev[ch].bus, dev[ch].busPath, dev[ch].addr, busBackends,
+		   busErr, sizeof busErr) == -1)
+      cmdLineErr("%s: %s\n", dev[ch].busPath, busErr);
+    dev[ch].bus.timing = &busTiming;
+  }
 
 #ifdef DEBUG
   printf("Effective gid exactly after opening file:%d\n", (int)egid);
@@ -193,73 +376,57 @@ int main(int argc, char *argv[])
   printf("Effective gid back in real gid: %d, security\n", (int)egid);
 #endif // DEBUG
 
-  #ifdef DEBUG
-  
-  // Read init data from configuration register of INA219
-  memset(RDbuf, 0, I2C_BUF_SIZE);
-  numRead = i2c_read_data_word(i2cfd, &configuration, RDbuf);
-  if (numRead == -1)
-    errExit("i2c_read_data_word-config-reg-init");
+  /* Metrics are inherited by every process forked from now on,
+     device setup already times its i2c transactions */
+  metCreate();
 
-  strtosh(RDbuf, confRegVal);
+  // Configure every device, -d settings go on top of -c ones
+  for (ch = 0; ch < ndev; ch++)
+    inaSetup(&dev[ch], confArgs, devArgs[ch]);
 
+/************************ Start acquisition ****************************/
 
-  printf("The init value of configuration register: 0x%02hx\n", confRegVal);
-#endif // DEBUG
-  
-/***** Set configuration register to 0x199f and re-read its value *****/
+  /* From now on only acquisition process reads INA219. Client handlers
+     take the latest sample from shared cache, so bus load does not
+     grow with number of connected clients */
+  acqShm = acqCreate(ndev);
 
-  // Configure confRegValto value 0x199f (0x1fff)
-  confRegVal= setreg(shuntBusCont, SADC_Sample128, BADC_Sample128, PGA_gain8);
-
-  // Write confRegVal value in configuration register
-  numWritten = i2c_write_data_word(i2cfd, &configuration, confRegVal);
-  if (numWritten == -1)
-    errExit("write-set-conf-register");
+  // Sample ring is a bonus for local readers, server works without it
+  for (ch = 0; ch < ndev; ch++) {
+    ringChanName(ringChName, sizeof ringChName, ringName, ch);
+    dev[ch].ring = ringCreate(ringChName, RING_SLOTS,
+			      acqConvPeriodUs(dev[ch].conf.confRegVal));
+    if (dev[ch].ring == NULL)
+      errMsg("ringCreate(%s)", ringChName);
+  }
 
-#ifdef DEBUG
-  // Re-read, if confRegVal value set correctly in configuration register
-  memset(RDbuf, 0, I2C_BUF_SIZE);
-  numRead = i2c_read_data_word(i2cfd, &configuration, RDbuf);
-  if (numRead == -1)
-    errExit("read-set-conf-register");
+  acqWorkers = acqStart(acqShm, dev, acqPid);
 
-  strtosh(RDbuf, confRegVal)
-	  
-  printf("The set value of config register: 0x%02hx\n", confRegVal);
-#endif // DEBUG
+  // Server itself does not need i2c devices anymore
+  for (ch = 0; ch < ndev; ch++)
+    inaBusClose(&dev[ch].bus);
 
-/**************** Check init value of calibration register ****************/
 #ifdef DEBUG
-  memset(RDbuf, 0, I2C_BUF_SIZE);
-  numRead = i2c_read_data_word(i2cfd, &calibration, RDbuf);
-  if (numRead == -1)
-    errExit("i2c_read_data_word-calib-reg-init");
-
-  strtosh(RDbuf, calibRegVal)
-
-  printf("The init value of calibration register: 0x%02hx\n", calibRegVal);
+  for (ch = 0; ch < ndev; ch++)
+    printf("Channel %d: %s 0x%02x sampled every %ld us\n", ch,
+	   dev[ch].busPath, dev[ch].addr, acqShm->chan[ch].periodUs);
+  printf("%d acquisition process(es)\n", acqWorkers);
 #endif // DEBUG
-  
-/****** Set calibration register to 0x1400 and re-read its value ******/
 
-  // Write calibRegVal value in calibration register
-  calibRegVal= 0x1400;
-  numWritten = i2c_write_data_word(i2cfd, &calibration, calibRegVal);
-  if (numWritten == -1)
-    errExit("i2c_write_data_word-calib-reg-set");
+  // Logger reads the rings, disk never holds acquisition up
+  if (logDir != NULL) {
+    logPid = logStart(logDir, ringName, ndev);
+    cmdSetLogDir(logDir);
+  }
 
-#ifdef DEBUG
-  // Re-read calibRegVal value set correctly in calibration register
-  memset(RDbuf, 0, I2C_BUF_SIZE);
-  numRead = i2c_read_data_word(i2cfd, &calibration, RDbuf);
-  if (numRead == -1)
-    errExit("i2c_read_data_word-calib-reg-set");
+  // Prometheus scrapes over loopback, clients never see the listener
+  if (metPort != 0)
+    metPid = metStart(metPort, acqShm);
 
-  strtosh(RDbuf, calibRegVal)
-    
-  printf("The set value of calibration register: 0x%02hx\n", calibRegVal);
-#endif // DEBUG
+  /* Samples leave by the same interface clients come from, receivers
+     recover gaps from "log" command of this server */
+  if (mcastPort != 0)
+    mcastPid = mcastStart(mcastGroup, mcastPort, argv[optind], ringName, ndev);
 
   /********************************************************************
    **********************   SERVER SETTING   **************************
@@ -271,42 +438,86 @@ int main(int argc, char *argv[])
     errExit("socket(2)");
 
   // Make chosen interface address of server socket address either
-  if (getIfaddr(ssck, (struct sockaddr *)&addr_srvr, argv[1]) == -1)
-    errExit("getIfaddr()");
-  addr_srvr.sin_port = htons(2500);
-  addr_srvr.sin_family = AF_INET;
-
-  /* Set socket option to suppress EADDRINUSE error
-     More infor LPI Kerrisk ch. 61.10 */
-  if (setsockopt(ssck, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) == -1)
+  if (getIfaddr(ssck, (struct sockaddr *)&addr_srvr, argv[optind]) == -1) {
+    // Interface without address still leaves local clients served
+    if (localPath == NULL)
+      errExit("getIfaddr()");
+    errMsg("getIfaddr(%s), serving local clients only", argv[optind]);
+    close(ssck);
+    ssck = -1;
+  }
+
+  if (ssck != -1) {
+    addr_srvr.sin_port = htons(2500);
+    addr_srvr.sin_family = AF_INET;
+
+    /* Set socket option to suppress EADDRINUSE error
+       More infor LPI Kerrisk ch. 61.10 */
+    if (setsockopt(ssck, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) == -1)
       errExit("setsockopt(2)");
-      
+
+    /* Every reactor thread gets listener of its own on the same port,
+       kernel spreads new connections over their accept queues */
+    if (reactors > 1 &&
+	setsockopt(ssck, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) == -1)
+      errExit("setsockopt(SO_REUSEPORT)");
+
 #ifdef DEBUG
-  printf("IP address: %s\n", inet_ntoa(addr_srvr.sin_addr));
-  printf("Port: %u\n", ntohs(addr_srvr.sin_port));
+    printf("IP address: %s\n", inet_ntoa(addr_srvr.sin_addr));
+    printf("Port: %u\n", ntohs(addr_srvr.sin_port));
 #endif // DEBUG
 
-  // Bind the server address to socket:
-  len_inet = sizeof addr_srvr;
-  if (bind(ssck, (struct sockaddr*)&addr_srvr, len_inet) == -1)
-    errExit("bind(2)");
+    // Bind the server address to socket:
+    len_inet = sizeof addr_srvr;
+    if (bind(ssck, (struct sockaddr*)&addr_srvr, len_inet) == -1)
+      errExit("bind(2)");
 
-  /* Make socket listening */
-  ret = listen(ssck, 10);
-  if (ret == -1)
-    errExit("listen(2)");
+    /* Make socket listening */
+    ret = listen(ssck, backlog);
+    if (ret == -1)
+      errExit("listen(2)");
+  }
+
+  /* Local clients skip TCP/IP stack. Blocking modes wait for both
+     listeners by poll(), neither of them may block in accept() */
+  if (localPath != NULL) {
+    usck = localListen(localPath, backlog, localGid);
+    if (usck == -1)
+      errExit("localListen(%s)", localPath);
+    if (ssck != -1 && ((ret = fcntl(ssck, F_GETFL)) == -1 ||
+		       fcntl(ssck, F_SETFL, ret | O_NONBLOCK) == -1))
+      errExit("fcntl(ssck, O_NONBLOCK)");
+  }
+
+  /* In epoll mode single process serves all clients, by one reactor
+     or one per core. It never returns */
+  if (srvMode == SRV_EPOLL && reactors > 1) {
+    rsck[0] = ssck;
+    for (i = 1; i < reactors; i++)
+      rsck[i] = ssck != -1 ? reusePortListen(&addr_srvr, backlog) : -1;
+    epollServeCores(rsck, reactors, usck, acqShm);
+  }
+  if (srvMode == SRV_EPOLL)
+    epollServe(ssck, usck, acqShm);
+
+  /* Prefork workers accept themselves, server only replaces those
+     which exit, it never returns either */
+  if (srvMode == SRV_PREFORK)
+    poolServe(ssck, usck, acqShm, workers, maxConns);
 
   /* Start processing clients requests */
   while (1) {
 
-    /* Wait for any client to connect */
-    
-    /* get ready the length of client's address structure 
-       pass it as "result-value" to accept syscall */
-    len_inet = sizeof addr_clnt;    
-csck = accept(ssck, (struct sockaddr *)&addr_clnt, (socklen_t *)&addr_clnt);
-    if (csck == -1)
+    /* Wait for any client to connect, on TCP or local listener.
+       Aborted connection and refused local peer are just skipped */
+    csck = localAccept(ssck, usck);
+    if (csck == -1) {
+      if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN ||
+	  errno == EACCES)
+	continue;
       errExit("accept(2)");
+    }
+    acceptNs = metNow();
 
     /* Fork to process new client's accepted connection */
     switch (chldPid = fork()) {
@@ -320,222 +531,17 @@ csck = accept(ssck, (struct sockaddr *)&addr_clnt, (socklen_t *)&addr_clnt);
     case 0:               // Child process
 
       // Close copy of unneeded listening socket
-      if (close(ssck) == -1)    
+      if (ssck != -1 && close(ssck) == -1)    
 	fprintf(stderr,
 		"%s close(ssck)\n", strerror(errno));
+      if (usck != -1)
+	close(usck);
       
-      // Create streams:
-      rx = fdopen(csck, "r");
-      if ( !rx ) {           // If rx stream creation failed
-	_exit(EXIT_FAILURE);
-      }
-
-      tx = fdopen(dup(csck), "w");
-      if ( !tx ) {           // If tx stream creation failed
-	fclose(rx);
-	_exit(EXIT_FAILURE);
-      }
-
-      // Set both streams to line buffered mode
-      setlinebuf(rx);
-      setlinebuf(tx);
-
   /* Process client's request. In our case it is reading voltage
      current and log from INA219 measuring system and transmitting 
-     it back to client */
-
-      // Clear I/O buffer
-      memset(buf, 0, sizeof buf);
-      
-      while ( fgets(buf, sizeof buf, rx) ) {
-	strtok(buf, "\r\n");
-	// buf[strlen(buf) - 2] = '\0';   // Terminate command with nul
-
-/**********************************   Voltage   ************************************/
-	if ( !strcmp(buf, "voltage") ) {
-
-	  // Read value from shunt voltage register
-	  numRead = i2c_read_data_word(i2cfd, &shunt, RDbuf);
-	  if (numRead == -1) {
-	    fprintf(tx,
-		    "{ \"ERROR\":\"i2c_read_data_word(shunt-volt-reg)\" }\n");
-	    fclose(tx);
-	    shutdown(fileno(rx), SHUT_RDWR);
-	    fclose(rx);
-	  
-	    _exit(EXIT_FAILURE);
-	  }
-     
-	  strtosh(RDbuf, sIna_measuring.shuntRegVal)
-       
-	    // If negative voltage convert it to positive
-	    if (sign(sIna_measuring.shuntRegVal) == -1) {
-	      sIna_measuring.complVal = complement(sIna_measuring.shuntRegVal);
-	      realShuntVoltVal = shuntVoltConv(sIna_measuring.complVal);
-	    }
-	    else {
-	      realShuntVoltVal = shuntVoltConv(sIna_measuring.shuntRegVal);
-	    }
-       
-	  /* Read value from bus voltage register
-	   * Check if data converted and get bus voltage real value
-	   */
-	  numRead = i2c_read_data_word(i2cfd, &bus, RDbuf);
-	  if (numRead == -1) {
-	    fprintf(tx,
-		    "{ \"ERROR\":\"i2c_read_data_word(bus-volt-reg)\" }\n");
-	    fclose(tx);
-	    shutdown(fileno(rx), SHUT_RDWR);
-	    fclose(rx);
-	  
-	    _exit(EXIT_FAILURE);       // _exit should close all open file descriptors
-	  }
-
-	  strtosh(RDbuf, sIna_measuring.busRegVal)
-	  
-#ifdef DEBUG
-	    // printf("The value of busRegVal: 0x%02hx\n", sIna_measuring.busRegVal);
-#endif //DEBUG
-     
-	    if (sIna_measuring.busRegVal & CNVR) 
-	      realBusVoltVal = busVoltConv(sIna_measuring.busRegVal);
-	    else{
-	      //     printf("Bus voltage not measured this time\n");
-	    }
-	
-#ifdef JSON
-	  fprintf(tx, "{ \"timestamp\":\"%s\", \"voltage\":%.2f };\n",
-		  currTime("%d/%m/%y %T"), realBusVoltVal + realShuntVoltVal / 1000);
-#else // JSON
-	  fprintf(tx, "The actual value of shunt voltage: %.2f mV\n", realShuntVoltVal);
-	  fprintf(tx, "The actual value of bus voltage: %.2f\n", realBusVoltVal);
-#endif // JSON
-
-       }
-
-
-/**********************************   Current    **********************************/
-	else if ( !strcmp(buf, "current") ) {
-
-	  // Read value from current register
-	  numRead = i2c_read_data_word(i2cfd, &current, RDbuf);
-	  if (numRead == -1) {
-	    fprintf(tx,
-		    "{ \"ERROR\":\"i2c_read_data_word(current-reg)\" }\n");
-	    fclose(tx);
-	    shutdown(fileno(rx), SHUT_RDWR);
-	    fclose(rx);
-	  
-	    _exit(EXIT_FAILURE);
-	  }
-
-	  strtosh(RDbuf, sIna_measuring.currRegVal)
-
-	    realCurrVal = currConv(sIna_measuring.currRegVal);
-
-#ifdef JSON
-	  fprintf(tx, "{ \"timestamp\":\"%s\", \"current\":%.2f };\n",
-		  currTime("%d/%m/%y %T"), realCurrVal);
-#else // JSON
-	  fprintf(tx, "The actual value of current: %.2f A\n", realCurrVal);
-#endif // JSON
-
-	}
-
-/*************************************    log    ***********************************/
-	else if ( !strcmp(buf, "log") ) {
-
-	  // Read value from shunt voltage register
-	  numRead = i2c_read_data_word(i2cfd, &shunt, RDbuf);
-	  if (numRead == -1) {
-	    fprintf(tx,
-		    "{ \"ERROR\":\"i2c_read_data_word(shunt-volt-reg)\" }\n");
-	    fclose(tx);
-	    shutdown(fileno(rx), SHUT_RDWR);
-	    fclose(rx);
-	   
-	    _exit(EXIT_FAILURE);
-	  }
-
-	  strtosh(RDbuf, sIna_measuring.shuntRegVal)
-
-	    // Read value from bus voltage register
-	    numRead = i2c_read_data_word(i2cfd, &bus, RDbuf);
-	  if (numRead == -1) {
-	    fprintf(tx,
-		    "{ \"ERROR\":\"i2c_read_data_word(bus-volt-reg)\" }\n");
-	    fclose(tx);
-	    shutdown(fileno(rx), SHUT_RDWR);
-	    fclose(rx);
-	   
-	    _exit(EXIT_FAILURE);
-	  }
-
-	  // Convert shunt-voltage. If negative voltage convert it to positive
-	  if (sign(sIna_measuring.shuntRegVal) == -1) {
-	    sIna_measuring.complVal = complement(sIna_measuring.shuntRegVal);
-	    realShuntVoltVal = shuntVoltConv(sIna_measuring.complVal);
-	  }
-	  else {
-	    realShuntVoltVal = shuntVoltConv(sIna_measuring.shuntRegVal);
-	  }
-	 
-	  // Make bus voltage conversions
-	  strtosh(RDbuf, sIna_measuring.busRegVal)
-	    if (sIna_measuring.busRegVal & CNVR) 
-	      realBusVoltVal = busVoltConv(sIna_measuring.busRegVal);
-
-	  // Read value from current register
-	  numRead = i2c_read_data_word(i2cfd, &current, RDbuf);
-	  if (numRead == -1) {
-	    fprintf(tx,
-		    "{ \"ERROR\":\"i2c_read_data_word(current-reg)\" }\n");
-	    fclose(tx);
-	    shutdown(fileno(rx), SHUT_RDWR);
-	    fclose(rx);
-	   
-	    _exit(EXIT_FAILURE);
-	  }
-
-	  // Make current conversions
-	  strtosh(RDbuf, sIna_measuring.currRegVal)
-	    realCurrVal = currConv(sIna_measuring.currRegVal);
-	 
-#ifdef DEBUG
-	  //       printf("The value of busRegVal: 0x%02hx\n", sIna_measuring.busRegVal);
-#endif //DEBUG
-     
-#ifdef JSON
-	  fprintf(tx, "{\n\"log\":{ \"timestamp\":\"%s\", \"voltage\":%.2f, \"current\":%.2f }\n}\n",
-		  currTime("%d/%m/%y %T"), realBusVoltVal + (realShuntVoltVal / 1000), realCurrVal);
-#else // JSON
-	  fprintf(tx, "The actual value of shunt voltage: %.2f mV\n", realShuntVoltVal);
-	  fprintf(tx, "The actual value of bus voltage: %.2f\n", realBusVoltVal);
-#endif // JSON
-
-	}
-
-      /*****************************************  exit  *******************************************/
-	else if ( !strcmp(buf, "exit") ) {
-	  fclose(tx);
-	  shutdown(fileno(rx), SHUT_RDWR);
-	  fclose(rx);
-	  _exit(EXIT_SUCCESS);
-	}
-
-
-      /****************************************  Unknown command  *********************************/
-	else {
-#ifdef JSON
-	  fprintf(tx, "{ \"WARN\":\"Unrecognized command! Valid commands are: 'voltage', 'current', 'log', 'exit'\" }\n");
-#else //JSON
-	  fprintf(tx, "Unrecognized command!\n"
-		  "Valid commands are: \'voltage\', \'current\', \'log\', \'exit\'\n");
-#endif //JSON
-	
-	}
-      }
-      
+     it back to client, or pushing it while client streams */
+      metObserve(MET_CONN_SPAWN, metNow() - acceptNs);
+      _exit(connServe(csck, acqShm));
 
     default :
       close(csck);     // Uneeded copy of client's connected socket
@@ -555,3 +561,117 @@ csck = accept(ssck, (struct sockaddr *)&addr_clnt, (socklen_t *)&addr_clnt);
 
 /***************** Local Functions Definitions ******************/
 // Must be labeled "static"
+
+/* Write configuration and calibration of one INA219, default one
+ * changed by confArgs of -c and then by devArgs of its -d option.
+ * Written values are left in dev->conf */
+static void inaSetup(acq_dev_s *dev, const char *confArgs, char *devArgs)
+{
+  int numRead, numWritten;
+  short confRegVal = 0,
+    calibRegVal = 0;
+  char args[BUF_SIZE], confErr[160];
+
+#ifdef DEBUG
+  // Read init data from configuration register of INA219
+  numRead = inaRegRead(&dev->bus, config_reg, &confRegVal);
+  if (numRead == -1)
+    errExit("i2c_read_data_word-config-reg-init");
+
+
+  printf("The init value of configuration register: 0x%02hx\n", confRegVal);
+#endif // DEBUG
+  
+/***** Set configuration register to 0x199f and re-read its value *****/
+
+  /* Configure confRegValto value 0x199f (0x1fff), unless command line
+     asks for something else */
+  confRegVal= setreg(shuntBusCont, SADC_Sample128, BADC_Sample128, PGA_gain8);
+  confDefault(&dev->conf, confRegVal);
+  if (confArgs != NULL) {
+    // Parsing cuts the string, every device gets its own copy
+    snprintf(args, sizeof args, "%s", confArgs);
+    if (confParse(&dev->conf, args, confErr, sizeof confErr) == -1)
+      cmdLineErr("-c: %s\n", confErr);
+  }
+  if (devArgs != NULL && confParse(&dev->conf, devArgs, confErr, sizeof confErr) == -1)
+    cmdLineErr("-d %s 0x%02x: %s\n", dev->busPath, dev->addr, confErr);
+  confRegVal = dev->conf.confRegVal;
+
+  // Write confRegVal value in configuration register
+  numWritten = inaRegWrite(&dev->bus, config_reg, confRegVal);
+  if (numWritten == -1)
+    errExit("write-set-conf-register");
+
+#ifdef DEBUG
+  // Re-read, if confRegVal value set correctly in configuration register
+  numRead = inaRegRead(&dev->bus, config_reg, &confRegVal);
+  if (numRead == -1)
+    errExit("read-set-conf-register");
+
+  printf("The set value of config register: 0x%02hx\n", confRegVal);
+#endif // DEBUG
+
+/**************** Check init value of calibration register ****************/
+#ifdef DEBUG
+  numRead = inaRegRead(&dev->bus, calib_reg, &calibRegVal);
+  if (numRead == -1)
+    errExit("i2c_read_data_word-calib-reg-init");
+
+  printf("The init value of calibration register: 0x%02hx\n", calibRegVal);
+#endif // DEBUG
+  
+/*** Set calibration register (0x1400 by default) and re-read it ****/
+
+  // Write calibRegVal value in calibration register
+  calibRegVal= dev->conf.calibRegVal;
+  numWritten = inaRegWrite(&dev->bus, calib_reg, calibRegVal);
+  if (numWritten == -1)
+    errExit("i2c_write_data_word-calib-reg-set");
+
+#ifdef DEBUG
+  // Re-read calibRegVal value set correctly in calibration register
+  numRead = inaRegRead(&dev->bus, calib_reg, &calibRegVal);
+  if (numRead == -1)
+    errExit("i2c_read_data_word-calib-reg-set");
+
+  printf("The set value of calibration register: 0x%02hx\n", calibRegVal);
+#endif // DEBUG
+}
+
+/* One more listening socket on addr, port shared with the others by
+ * SO_REUSEPORT */
+static int reusePortListen(struct sockaddr_in *addr, int backlog)
+{
+  int sck, optval = 1;
+
+  sck = socket(AF_INET, SOCK_STREAM, 0);
+  if (sck == -1)
+    errExit("socket(2)");
+
+  if (setsockopt(sck, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) == -1 ||
+      setsockopt(sck, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) == -1)
+    errExit("setsockopt(SO_REUSEPORT)");
+
+  if (bind(sck, (struct sockaddr *)addr, sizeof(struct sockaddr_in)) == -1)
+    errExit("bind(2)");
+  if (listen(sck, backlog) == -1)
+    errExit("listen(2)");
+
+  return sck;
+}
+
+// Timing hook of INAburst, INA_OP_* to i2c histogram of metrics
+static void busObserve(int op, long long ns)
+{
+  static const int busMet[] = { MET_I2C_READ, MET_I2C_WRITE, MET_I2C_BURST };
+
+  metObserve(busMet[op], ns);
+}
+
+/* Message of SIGCHLD handler to stderr, async-signal-safe. Failed write
+ * is ignored, there is nowhere else to report it */
+static void sigWrite(const char *msg)
+{
+  if (write(STDERR_FILENO, msg, strlen(msg)) == -1) {}
+}
@@ -0,0 +1,132 @@
+/*****************************************************************
+ * Title    : INAstats.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Bucketed Welford statistics described in INAstats.h.
+ *            Adding a sample is O(1), query merges buckets of the
+ *            window, so its cost does not grow with sample rate
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <math.h>
+#include <string.h>
+#include "INAstats.h"
+
+/**************** Global Functions Definitions ******************/
+
+/* Add one sample taken at tsNs (CLOCK_MONOTONIC), only acquisition
+ * worker of the channel calls it. Bucket left from STATS_BUCKETS
+ * buckets ago is started over */
+void statsAdd(stats_chan_s *sc, int64_t tsNs, double volt, double curr)
+{
+  int64_t id = tsNs / STATS_BUCKET_NS;
+  stats_bucket_s *b = &sc->bucket[id % STATS_BUCKETS];
+  uint32_t lock;
+
+  lock = __atomic_load_n(&b->lock, __ATOMIC_RELAXED);
+  __atomic_store_n(&b->lock, lock + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  if (b->id != id) {
+    memset(&b->volt, 0, sizeof(stats_agg_s));
+    memset(&b->curr, 0, sizeof(stats_agg_s));
+    b->id = id;
+  }
+  statsAggAdd(&b->volt, volt);
+  statsAggAdd(&b->curr, curr);
+
+  __atomic_store_n(&b->lock, lock + 2, __ATOMIC_RELEASE);
+}
+
+/* Statistics of samples of the last windowNs before nowNs, rounded up
+ * to whole buckets and limited to buckets kept. Returns number of
+ * samples */
+uint32_t statsQuery(stats_chan_s *sc, int64_t nowNs, int64_t windowNs,
+		    stats_agg_s *volt, stats_agg_s *curr)
+{
+  int64_t nowId = nowNs / STATS_BUCKET_NS;
+  int64_t nb, id;
+  stats_bucket_s *b, copy;
+  uint32_t lock1, lock2;
+
+  nb = (windowNs + STATS_BUCKET_NS - 1) / STATS_BUCKET_NS;
+  if (nb > STATS_BUCKETS)
+    nb = STATS_BUCKETS;
+
+  memset(volt, 0, sizeof(stats_agg_s));
+  memset(curr, 0, sizeof(stats_agg_s));
+
+  for (id = nowId - nb + 1; id <= nowId; id++) {
+    b = &sc->bucket[id % STATS_BUCKETS];
+
+    // Only the current bucket is being written, others copy at once
+    do {
+      lock1 = __atomic_load_n(&b->lock, __ATOMIC_ACQUIRE);
+      copy = *b;
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      lock2 = __atomic_load_n(&b->lock, __ATOMIC_RELAXED);
+    } while ((lock1 & 1) || lock1 != lock2);
+
+    // Bucket of other time, no sample came in this one
+    if (copy.id != id)
+      continue;
+
+    statsMerge(volt, &copy.volt);
+    statsMerge(curr, &copy.curr);
+  }
+
+  return volt->n;
+}
+
+// Add sample x to aggregate a, Welford update
+void statsAggAdd(stats_agg_s *a, double x)
+{
+  double delta;
+
+  if (a->n == 0 || x < a->min)
+    a->min = x;
+  if (a->n == 0 || x > a->max)
+    a->max = x;
+
+  a->n++;
+  delta = x - a->mean;
+  a->mean += delta / a->n;
+  a->m2 += delta * (x - a->mean);
+}
+
+/* Merge aggregate b into a, parallel variant of Welford algorithm
+ * (Chan et al.) */
+void statsMerge(stats_agg_s *a, const stats_agg_s *b)
+{
+  double delta, n;
+
+  if (b->n == 0)
+    return;
+  if (a->n == 0) {
+    *a = *b;
+    return;
+  }
+
+  n = (double)a->n + b->n;
+  delta = b->mean - a->mean;
+  a->mean += delta * b->n / n;
+  a->m2 += b->m2 + delta * delta * ((double)a->n * b->n / n);
+  if (b->min < a->min)
+    a->min = b->min;
+  if (b->max > a->max)
+    a->max = b->max;
+  a->n += b->n;
+}
+
+// Population standard deviation
+double statsStd(const stats_agg_s *a)
+{
+  return a->n ? sqrt(a->m2 / a->n) : 0.0;
+}
+
+// Root mean square, mean of squares is variance plus squared mean
+double statsRms(const stats_agg_s *a)
+{
+  return a->n ? sqrt(a->m2 / a->n + a->mean * a->mean) : 0.0;
+}
@@ -0,0 +1,58 @@
+/*****************************************************************
+ * Title    : INAstats.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Running statistics of voltage and current, kept by
+ *            acquisition over every conversion and queried over
+ *            sliding time window by "stats" command
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INASTATS_H
+#define INASTATS_H
+
+/************************** Includes ****************************/
+#include <stdint.h>
+
+/************ Global Symbolic Constant Definitions **************/
+
+/* Time is cut to buckets, window is made of whole buckets. Buckets
+ * are kept for STATS_BUCKETS * STATS_BUCKET_NS, 5 minutes */
+#define STATS_BUCKET_NS  100000000LL
+#define STATS_BUCKETS    3000
+
+/**************** New Global Types Definitions ******************/
+
+/* Welford aggregate of one quantity. Aggregates of disjoint sample
+ * sets merge exactly, see statsMerge() */
+typedef struct stats_agg {
+  uint32_t n;
+  double min, max;
+  double mean;
+  double m2;                    // Sum of squared differences from mean
+} stats_agg_s;
+
+/* Samples of one bucket. "lock" is seqlock sequence, odd while
+ * acquisition worker updates the bucket */
+typedef struct stats_bucket {
+  uint32_t lock;
+  int64_t id;                   // CLOCK_MONOTONIC ns / STATS_BUCKET_NS
+  stats_agg_s volt;
+  stats_agg_s curr;
+} stats_bucket_s;
+
+// Ring of buckets of one channel, bucket id is kept in id % STATS_BUCKETS
+typedef struct stats_chan {
+  stats_bucket_s bucket[STATS_BUCKETS];
+} stats_chan_s;
+
+/************** Global Functions Prototype Declarations *********/
+
+void statsAdd(stats_chan_s *sc, int64_t tsNs, double volt, double curr);
+uint32_t statsQuery(stats_chan_s *sc, int64_t nowNs, int64_t windowNs,
+		    stats_agg_s *volt, stats_agg_s *curr);
+void statsAggAdd(stats_agg_s *a, double x);
+void statsMerge(stats_agg_s *a, const stats_agg_s *b);
+double statsStd(const stats_agg_s *a);
+double statsRms(const stats_agg_s *a);
+
+#endif // INASTATS_H
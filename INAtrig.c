@@ -0,0 +1,226 @@
+/*****************************************************************
+ * Title    : INAtrig.c
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Triggered capture, oscilloscope-like. Armed trigger
+ *            keeps last conversions in circular buffer of its own,
+ *            when condition is met it takes the post-trigger ones
+ *            and freezes the buffer until it is armed again. Worker
+ *            side allocates nothing and takes no lock per sample
+ * Version  : 1.0
+ ****************************************************************/
+
+/************************** Includes ****************************/
+#include <pthread.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/error_functions.h"
+#include "INAacq.h"
+#include "INAtrig.h"
+
+/********* Static Local Functions Prototype Declarations ********/
+
+static void trigApply(trig_chan_s *tc);
+static int trigCheck(trig_chan_s *tc, int64_t val);
+static void trigKeep(trig_chan_s *tc, const ring_sample_s *rs);
+static void infoBegin(trig_chan_s *tc);
+static void infoEnd(trig_chan_s *tc, uint32_t state);
+static void trigLock(trig_chan_s *tc);
+
+/**************** Global Functions Definitions ******************/
+
+// Mutex attributes are those of configuration mailbox
+void trigInit(trig_chan_s *tc, const pthread_mutexattr_t *attr)
+{
+  int s;
+
+  s = pthread_mutex_init(&tc->mutex, attr);
+  if (s != 0)
+    errExitEN(s, "pthread_mutex_init(trig)");
+}
+
+/* Called by acquisition worker with every published sample smp, rs
+ * is the same one as it goes to the ring. Trigger which is not armed
+ * costs one atomic load. Condition is checked only once pre-trigger
+ * samples fill the buffer, so capture always has all of them */
+void trigPush(trig_chan_s *tc, const acq_sample_s *smp, const ring_sample_s *rs)
+{
+  trig_info_s *info = &tc->info;
+  int64_t val;
+
+  if (__atomic_load_n(&tc->reqSeq, __ATOMIC_ACQUIRE) != info->id)
+    trigApply(tc);
+
+  // Stale sample repeats conversion which is kept already
+  if (info->state == TRIG_IDLE || info->state == TRIG_DONE || !acqFresh(smp))
+    return;
+
+  trigKeep(tc, rs);
+
+  if (info->state == TRIG_FIRED) {
+    if (--tc->left == 0) {
+      infoBegin(tc);
+      info->first = tc->pos;
+      infoEnd(tc, TRIG_DONE);
+    }
+    return;
+  }
+
+  // Failed read has no value, rise and fall start over after it
+  if (smp->err & (ACQ_ERR_SHUNT | ACQ_ERR_BUS | ACQ_ERR_CURR)) {
+    tc->havePrev = 0;
+    return;
+  }
+
+  val = (info->cond.quantity == TRIG_CURRENT) ? acqCurrentUa(smp) : acqVoltageUv(smp);
+  if (!trigCheck(tc, val) || tc->kept <= info->cond.pre)
+    return;
+
+  // Trigger conversion is the first of post-trigger ones
+  infoBegin(tc);
+  info->trigSeq = rs->seq;
+  info->trigNs = rs->tsNs;
+  info->trigVal = val;
+  tc->left = info->cond.post - 1;
+  info->first = tc->pos;
+  infoEnd(tc, tc->left ? TRIG_FIRED : TRIG_DONE);
+}
+
+/* Post request cond to acquisition worker, post 0 disarms. Returns
+ * its id, trig_info_s.id becomes it once the worker took it */
+uint32_t trigArm(trig_chan_s *tc, const trig_cond_s *cond)
+{
+  uint32_t id;
+
+  trigLock(tc);
+  tc->req = *cond;
+  id = tc->reqSeq + 1;
+  __atomic_store_n(&tc->reqSeq, id, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&tc->mutex);
+
+  return id;
+}
+
+/* Copy state of capture to info and, when it is TRIG_DONE, up to max
+ * of its samples from from-th one on, oldest is 0 and trigger one is
+ * info->cond.pre, to buf. Returns number of samples copied. Seqlock
+ * reader side, retries while worker changes the capture */
+int trigRead(trig_chan_s *tc, trig_info_s *info, uint32_t from,
+	     ring_sample_s *buf, int max)
+{
+  uint32_t seq1, seq2, cap, i;
+  int n;
+
+  do {
+    seq1 = __atomic_load_n(&tc->lock, __ATOMIC_ACQUIRE);
+    *info = tc->info;
+
+    // Torn info must not take the copy out of sample[]
+    n = 0;
+    cap = info->cond.pre + info->cond.post;
+    if (info->state == TRIG_DONE && cap <= TRIG_MAX_SAMPLES &&
+	info->first < cap)
+      for (i = from; i < cap && n < max; i++, n++)
+	buf[n] = tc->sample[(info->first + i) % cap];
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    seq2 = __atomic_load_n(&tc->lock, __ATOMIC_RELAXED);
+  } while ((seq1 & 1) || seq1 != seq2);
+
+  return n;
+}
+
+const char *trigStateName(uint32_t state)
+{
+  static const char *name[] = { "idle", "armed", "fired", "done" };
+
+  return (state <= TRIG_DONE) ? name[state] : "?";
+}
+
+/***************** Local Functions Definitions ******************/
+
+// Take latest request, arming starts with empty buffer
+static void trigApply(trig_chan_s *tc)
+{
+  trig_info_s *info = &tc->info;
+
+  infoBegin(tc);
+
+  trigLock(tc);
+  info->id = tc->reqSeq;
+  info->cond = tc->req;
+  pthread_mutex_unlock(&tc->mutex);
+
+  info->trigSeq = 0;
+  info->trigNs = 0;
+  info->trigVal = 0;
+  info->first = 0;
+  tc->pos = tc->kept = 0;
+  tc->havePrev = 0;
+
+  infoEnd(tc, info->cond.post ? TRIG_ARMED : TRIG_IDLE);
+}
+
+// Is condition met by value val of watched quantity
+static int trigCheck(trig_chan_s *tc, int64_t val)
+{
+  const trig_cond_s *cond = &tc->info.cond;
+  int fire = 0;
+
+  switch (cond->edge) {
+  case TRIG_ABOVE:
+    fire = val > cond->level;
+    break;
+  case TRIG_BELOW:
+    fire = val < cond->level;
+    break;
+  case TRIG_RISE:
+    fire = tc->havePrev && val - tc->prev >= cond->level;
+    break;
+  case TRIG_FALL:
+    fire = tc->havePrev && tc->prev - val >= cond->level;
+    break;
+  }
+
+  tc->prev = val;
+  tc->havePrev = 1;
+
+  return fire;
+}
+
+// Put sample in circular buffer of pre + post samples
+static void trigKeep(trig_chan_s *tc, const ring_sample_s *rs)
+{
+  uint32_t cap = tc->info.cond.pre + tc->info.cond.post;
+
+  tc->sample[tc->pos] = *rs;
+  if (++tc->pos == cap)
+    tc->pos = 0;
+  if (tc->kept < cap)
+    tc->kept++;
+}
+
+/* Writer side of info seqlock. Samples written after infoBegin() are
+ * seen by readers as change too, see trigRead() */
+static void infoBegin(trig_chan_s *tc)
+{
+  __atomic_store_n(&tc->lock, tc->lock + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void infoEnd(trig_chan_s *tc, uint32_t state)
+{
+  tc->info.state = state;
+  __atomic_store_n(&tc->lock, tc->lock + 1, __ATOMIC_RELEASE);
+}
+
+// Client holding the mutex may die, robust mutex lets the rest go on
+static void trigLock(trig_chan_s *tc)
+{
+  int s;
+
+  s = pthread_mutex_lock(&tc->mutex);
+  if (s == EOWNERDEAD)
+    s = pthread_mutex_consistent(&tc->mutex);
+  if (s != 0)
+    errExitEN(s, "pthread_mutex_lock(trig)");
+}
@@ -0,0 +1,96 @@
+/*****************************************************************
+ * Title    : INAtrig.h
+ * Author   : Martin Dida
+ * Date     : 17.Oct.2026
+ * Brief    : Triggered capture of conversions around an event,
+ *            condition is checked by acquisition worker at every
+ *            conversion, capture is read by "trigger" command
+ * Version  : 1.0
+ ****************************************************************/
+#ifndef INATRIG_H
+#define INATRIG_H
+
+/************************** Includes ****************************/
+#include <stdint.h>
+#include <pthread.h>
+#include "INAring.h"
+
+/************ Global Symbolic Constant Definitions **************/
+
+// Samples of one capture, pre-trigger and post-trigger ones together
+#define TRIG_MAX_SAMPLES  2048
+#define TRIG_DEF_PRE      256
+#define TRIG_DEF_POST     768
+
+// Quantity condition watches
+#define TRIG_CURRENT  0
+#define TRIG_VOLTAGE  1
+
+// Condition on watched quantity against level
+#define TRIG_ABOVE    0         // Value is above level
+#define TRIG_BELOW    1         // Value is below level
+#define TRIG_RISE     2         // Rose by level or more since last conversion
+#define TRIG_FALL     3         // Fell by level or more since last conversion
+
+// States of capture
+#define TRIG_IDLE     0         // Nothing armed
+#define TRIG_ARMED    1         // Pre-trigger samples kept, condition watched
+#define TRIG_FIRED    2         // Taking post-trigger samples
+#define TRIG_DONE     3         // Capture complete, samples can be read
+
+/**************** New Global Types Definitions ******************/
+
+// Trigger condition and capture size, post 0 disarms the trigger
+typedef struct trig_cond {
+  int quantity;                 // TRIG_CURRENT or TRIG_VOLTAGE
+  int edge;                     // TRIG_ABOVE ... TRIG_FALL
+  int64_t level;                // uA or uV, per conversion for rise and fall
+  uint32_t pre;                 // Conversions kept before trigger one
+  uint32_t post;                // Trigger conversion and those after it
+} trig_cond_s;
+
+// What capture is at, written by acquisition worker
+typedef struct trig_info {
+  uint32_t state;               // TRIG_*, stored last
+  uint32_t id;                  // Request capture was armed by
+  trig_cond_s cond;
+  uint32_t trigSeq;             // Sequence number of trigger conversion
+  int64_t trigNs;               // and its wall time
+  int64_t trigVal;              // Value which met condition, uA or uV
+  uint32_t first;               // Oldest capture sample in sample[]
+} trig_info_s;
+
+/* Trigger of one channel. Clients post request like configuration
+ * mailbox, under robust process-shared "mutex", acquisition worker
+ * takes it at next conversion. Everything after "req" belongs to the
+ * worker, clients only read it through trigRead(). "lock" is seqlock
+ * sequence of info, odd while worker changes it, samples are only
+ * written while state is not TRIG_DONE */
+typedef struct trig_chan {
+  pthread_mutex_t mutex;
+  uint32_t reqSeq;              // Incremented with every request
+  trig_cond_s req;
+
+  uint32_t lock;
+  trig_info_s info;
+  int64_t prev;                 // Last watched value, rise and fall
+  int havePrev;
+  uint32_t pos;                 // Where next sample goes in sample[]
+  uint32_t kept;                // Samples in sample[], up to pre + post
+  uint32_t left;                // Post-trigger samples still to come
+  ring_sample_s sample[TRIG_MAX_SAMPLES];       // Circular, pre + post
+} trig_chan_s;
+
+struct acq_sample;
+
+/************** Global Functions Prototype Declarations *********/
+
+void trigInit(trig_chan_s *tc, const pthread_mutexattr_t *attr);
+void trigPush(trig_chan_s *tc, const struct acq_sample *smp,
+	      const ring_sample_s *rs);
+uint32_t trigArm(trig_chan_s *tc, const trig_cond_s *cond);
+int trigRead(trig_chan_s *tc, trig_info_s *info, uint32_t from,
+	     ring_sample_s *buf, int max);
+const char *trigStateName(uint32_t state);
+
+#endif // INATRIG_H